@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// start and end must be aligned to the 64 bytes cache line
+
+/// Cleans the data cache and invalidates the instruction cache of the range,
+/// for code written through data accesses
+extern void _cache_flush_range(uintptr_t start, uintptr_t end);
+
+/// Cleans the data cache of the range to the point of unification
+extern void _dcache_flush_range(uintptr_t start, uintptr_t end);
+
+/// Invalidates the instruction cache of the range
+extern void _icache_flush_range(uintptr_t start, uintptr_t end);
@@ -28,24 +28,22 @@ void arm_exceptions_disable(bool fiq, bool irq, bool serror, bool debug);
 size_t arm_get_exception_level();
 
 
+/// General purpose registers saved at exception entry. The fp/simd registers
+/// are not saved, the kernel does not use them (-mgeneral-regs-only) and the
+/// el0 ones are switched lazily (kernel/fpu.h)
 typedef struct {
-    uint64_t fpcr;
-    uint64_t fpsr;
-    uint64_t x[31];                 // x0-x30
-    _Alignas(16) uint64_t v[32][2]; // v0-v31
+    uint64_t x[31]; // x0-x30
+    uint64_t _pad;  // keeps sp 16 bytes aligned
 } arm_exception_ctx;
 #endif
 
 
-#define ARM_STRUCT_ECTX_SIZE 784
-#define ARM_STRUCT_ECTX_OFFSETOF_X 16
-#define ARM_STRUCT_ECTX_OFFSETOF_V 272
+#define ARM_STRUCT_ECTX_SIZE 256
+#define ARM_STRUCT_ECTX_OFFSETOF_X 0
 
 
 #ifndef __ASSEMBLER__
 _Static_assert(ARM_STRUCT_ECTX_SIZE == sizeof(arm_exception_ctx));
 _Static_assert(
     __builtin_offsetof(arm_exception_ctx, x) == ARM_STRUCT_ECTX_OFFSETOF_X);
-_Static_assert(
-    __builtin_offsetof(arm_exception_ctx, v) == ARM_STRUCT_ECTX_OFFSETOF_V);
 #endif
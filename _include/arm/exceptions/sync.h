@@ -5,6 +5,14 @@
 #define ESR_ISS(esr) ((esr) & 0x1FFFFFFULL)
 #define ESR_ISS2(esr) (((esr) >> 32) & 0xFFFFFFULL)
 
+// data abort iss
+#define ESR_DABT_DFSC(esr) ((esr) & 0x3FULL)
+#define ESR_DABT_WNR(esr) (((esr) >> 6) & 1ULL)
+// permission fault of any level (0b0011xx)
+#define ESR_DFSC_IS_PERMISSION(dfsc) (((dfsc) & 0x3CULL) == 0x0CULL)
+// translation fault of any level (0b0001xx), also the ifsc of an iabt
+#define ESR_DFSC_IS_TRANSLATION(dfsc) (((dfsc) & 0x3CULL) == 0x04ULL)
+
 typedef enum {
     ESR_EC_UNKNOWN = 0b000000,
     ESR_EC_WFI_WFE = 0b000001,
@@ -0,0 +1,41 @@
+#pragma once
+
+#define ARM_STRUCT_FPCTX_SIZE 528
+#define ARM_STRUCT_FPCTX_OFFSETOF_V 16
+
+#ifndef __ASSEMBLER__
+#    include <stdint.h>
+
+typedef struct {
+    uint64_t fpcr;
+    uint64_t fpsr;
+    _Alignas(16) uint64_t v[32][2]; // v0-v31
+} arm_fp_ctx;
+
+_Static_assert(ARM_STRUCT_FPCTX_SIZE == sizeof(arm_fp_ctx));
+_Static_assert(
+    __builtin_offsetof(arm_fp_ctx, v) == ARM_STRUCT_FPCTX_OFFSETOF_V);
+
+
+// CPACR_EL1.FPEN (bits 21:20)
+typedef enum {
+    ARM_FPEN_TRAP_ALL = 0b00,
+    ARM_FPEN_TRAP_EL0 = 0b01,
+    ARM_FPEN_TRAP_NONE = 0b11,
+} arm_fpen;
+
+extern uint64_t _ARM_CPACR_EL1_get(void);
+extern void _ARM_CPACR_EL1_set(uint64_t v);
+
+static inline void arm_set_fpen(arm_fpen fpen)
+{
+    uint64_t v = _ARM_CPACR_EL1_get();
+    _ARM_CPACR_EL1_set((v & ~(0b11ULL << 20)) | ((uint64_t)fpen << 20));
+}
+
+/// stores the fp/simd registers of the core
+extern void _ARM_fp_ctx_save(arm_fp_ctx* ctx);
+
+/// loads the fp/simd registers of the core
+extern void _ARM_fp_ctx_restore(const arm_fp_ctx* ctx);
+#endif
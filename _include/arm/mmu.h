@@ -36,11 +36,16 @@
 #define COREH_GRANULARITY_WIDTH 2
 #define COREH_GRANULARITY_MASK ((1ull << COREH_GRANULARITY_WIDTH) - 1)
 #define COREH_BIT_MASK(shift) (1ull << (shift))
-#define MMU_APPLY_CHANGES()       \
-    asm volatile("dsb ishst\n"    \
-                 "tlbi vmalle1\n" \
-                 "dsb ish\n"      \
-                 "isb\n");
+// can be predefined by host builds of the table code (tools/mmu_sim). The
+// invalidation is broadcast to the inner shareable domain, a table can be in
+// use by other cores (a task with threads in several of them, the kernel one)
+#ifndef MMU_APPLY_CHANGES
+#    define MMU_APPLY_CHANGES()         \
+        asm volatile("dsb ishst\n"      \
+                     "tlbi vmalle1is\n" \
+                     "dsb ish\n"        \
+                     "isb\n");
+#endif
 
 
 // TCR_EL1.TG0 encoding
@@ -54,6 +59,40 @@
 
 #define NULL_MAPPING_TBL (void*)~0ULL
 
+
+/// MAIR_EL1 attribute encodings
+/// https://df.lth.se/~getz/ARM/SysReg/AArch64-mair_el1.html
+#define MMU_MAIR_NORMAL_WB 0xFFULL // inner/outer WB non-transient, RW-allocate
+#define MMU_MAIR_NORMAL_WT 0xAAULL // inner/outer WT non-transient, R-allocate
+#define MMU_MAIR_NORMAL_NC 0x44ULL // inner/outer non-cacheable
+#define MMU_MAIR_DEVICE_NGNRE 0x04ULL
+#define MMU_MAIR_DEVICE_NGNRNE 0x00ULL
+
+#define MMU_MAIR_ATTR(index, attr) ((uint64_t)(attr) << ((index) * 8))
+
+/// attribute indexes of the default MAIR_EL1 set by mmu_core_handle_new
+typedef enum {
+    MMU_MT_NORMAL_WB = 0,
+    MMU_MT_DEVICE_NGNRE = 1,
+    MMU_MT_NORMAL_NC = 2, // write-combining
+    MMU_MT_NORMAL_WT = 3,
+    MMU_MT_DEVICE_NGNRNE = 4,
+    MMU_MT_COUNT,
+} mmu_memory_type;
+
+#define MMU_MAIR_DEFAULT                                         \
+    (MMU_MAIR_ATTR(MMU_MT_NORMAL_WB, MMU_MAIR_NORMAL_WB) |       \
+     MMU_MAIR_ATTR(MMU_MT_DEVICE_NGNRE, MMU_MAIR_DEVICE_NGNRE) | \
+     MMU_MAIR_ATTR(MMU_MT_NORMAL_NC, MMU_MAIR_NORMAL_NC) |       \
+     MMU_MAIR_ATTR(MMU_MT_NORMAL_WT, MMU_MAIR_NORMAL_WT) |       \
+     MMU_MAIR_ATTR(MMU_MT_DEVICE_NGNRNE, MMU_MAIR_DEVICE_NGNRNE))
+
+
+static inline bool mmu_memory_type_is_device(mmu_memory_type t)
+{
+    return t == MMU_MT_DEVICE_NGNRE || t == MMU_MT_DEVICE_NGNRNE;
+}
+
 typedef enum {
     MMU_GRANULARITY_4KB = 4 * MEM_KiB,
     MMU_GRANULARITY_16KB = 16 * MEM_KiB,
@@ -66,11 +105,31 @@ typedef enum {
 } mmu_tbl_rng;
 
 /// the return type must be a virtual address that is mapped according to the
-/// provided mmu physmap offset
+/// provided mmu physmap offset. The returned memory must be zeroed
 typedef void* (*mmu_allocator)(size_t bytes);
 typedef void (*mmu_allocator_free)(void* addr);
 typedef uint16_t (*mmu_coreid)(void);
 
+#define MMU_WALK_CACHE_ENTRIES 4
+
+/// deepest table found by a previous translation of the va span starting at
+/// va_base. seq is odd while the entry is being written
+typedef struct {
+    uint64_t seq;
+    uint64_t gen;
+    v_uintptr_t va_base;
+    void* tbl;
+    size_t lvl;
+} mmu_walk_cache_entry;
+
+/// entries are only valid for the generation they were filled in. Every op
+/// that can free or move tables bumps the generation
+typedef struct {
+    uint64_t gen;
+    size_t next;
+    mmu_walk_cache_entry entries[MMU_WALK_CACHE_ENTRIES];
+} mmu_walk_cache;
+
 typedef struct {
     mmu_tbl_rng rng_;
     mmu_granularity g_;
@@ -79,6 +138,7 @@ typedef struct {
     void* tbl_;
     mmu_allocator allocator_;
     mmu_allocator_free allocator_free_;
+    mmu_walk_cache walk_cache_;
 } mmu_mapping;
 
 extern const mmu_mapping MMU_NULL_MAPPING;
@@ -132,6 +192,7 @@ static inline void
 mmu_mapping_set_physmap_offset(mmu_mapping* m, uint64_t physmap_offset)
 {
     m->physmap_offset_ = physmap_offset;
+    m->walk_cache_.gen++;
 }
 
 static inline void
@@ -150,6 +211,7 @@ static inline void
 UNSAFE_mmu_mapping_set_tbl_address(mmu_mapping* m, void* addr)
 {
     m->tbl_ = addr;
+    m->walk_cache_.gen++;
 }
 
 typedef struct {
@@ -157,6 +219,7 @@ typedef struct {
     mmu_mapping* hi_mapping;
     uint32_t mpidr_aff;
     uint64_t flags;
+    uint64_t mair;
 } mmu_core_handle;
 
 
@@ -264,6 +327,11 @@ static inline uint32_t mmu_core_get_coreid(const mmu_core_handle* ch)
     return ch->mpidr_aff;
 }
 
+static inline uint64_t mmu_core_get_mair(const mmu_core_handle* ch)
+{
+    return ch->mair;
+}
+
 bool mmu_core_set_mapping(mmu_core_handle* ch, mmu_mapping* t);
 
 bool mmu_core_set_d_cache(mmu_core_handle* ch, bool v);
@@ -275,6 +343,8 @@ bool mmu_core_set_lo_va_bits(mmu_core_handle* ch, uint8_t bits);
 bool mmu_core_set_hi_va_bits(mmu_core_handle* ch, uint8_t bits);
 bool mmu_core_set_lo_granularity(mmu_core_handle* ch, mmu_granularity g);
 bool mmu_core_set_hi_granularity(mmu_core_handle* ch, mmu_granularity g);
+/// replaces the attribute of a MAIR_EL1 index (0..7), applied on activation
+bool mmu_core_set_mair_attr(mmu_core_handle* ch, uint8_t index, uint8_t attr);
 
 
 static inline mmu_mapping mmu_mapping_new(
@@ -299,6 +369,7 @@ static inline mmu_mapping mmu_mapping_new(
         .tbl_ = tbl,
         .allocator_ = allocator,
         .allocator_free_ = allocator_free,
+        .walk_cache_ = {.gen = 1},
     };
 }
 
@@ -430,7 +501,7 @@ static inline mmu_pg_cfg mmu_pg_cfg_new(
 }
 
 mmu_map_result mmu_map(
-    const mmu_mapping* m,
+    mmu_mapping* m,
     v_uintptr_t va,
     p_uintptr_t pa,
     size_t size,
@@ -443,6 +514,35 @@ typedef enum {
 } mmu_unmap_result;
 
 mmu_unmap_result
-mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info);
+mmu_unmap(mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info);
+
+/// worst case number of tables that mmu_map could allocate for the range
+size_t mmu_map_max_tbls(const mmu_mapping* m, v_uintptr_t va, size_t size);
+
+/// Replaces the tables fully inside [va, va + size) that map a fully populated,
+/// physically contiguous and uniformly configured range with a single block of
+/// the parent level, freeing them. It uses break-before-make, so the range must
+/// not be accessed by other cores while promoting it
+void mmu_promote(
+    mmu_mapping* m,
+    v_uintptr_t va,
+    size_t size,
+    mmu_op_info* info);
+
+typedef struct {
+    bool mapped;
+    p_uintptr_t pa;
+    size_t leaf_bytes; // bytes covered by the translating descriptor
+    mmu_pg_cfg cfg;
+} mmu_translation;
+
+/// Software walk of m for va. The upper levels are skipped when the walk cache
+/// of the mapping holds the table of the va span. Must not race with ops that
+/// modify the same range of m
+mmu_translation mmu_translate(mmu_mapping* m, v_uintptr_t va);
+
+/// Translates va with AT S1E1R through the mappings currently active on the
+/// calling core. Returns false if the hardware walk faults
+bool mmu_translate_current(v_uintptr_t va, p_uintptr_t* pa);
 
 bool mmu_is_active();
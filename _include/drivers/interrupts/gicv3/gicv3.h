@@ -68,4 +68,8 @@ void GICV3_init_irq(
     ARM_cpu_affinity cpu);
 
 
+/// Enables a private interrupt (sgi or ppi) of the redistributor of cpu
 void GICV3_enable_ppi(const driver_handle* h, irq_id id, ARM_cpu_affinity cpu);
+
+/// Sends the group 1 sgi id to cpu
+void GICV3_send_sgi(irq_id id, ARM_cpu_affinity cpu);
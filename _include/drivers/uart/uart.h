@@ -10,6 +10,20 @@
 
 #define UART_TX_BUF_SIZE 8192
 #define UART_RX_BUF_SIZE 1024
+#define UART_TX_SG_LEN 64 // power of 2
+
+
+typedef void (*uart_sg_done_t)(void* arg);
+
+/// Segment of a scatter gather write, sent straight from buf
+typedef struct {
+    const uint8_t* buf; // kernel va, valid until done is called
+    size_t len;         // > 0
+    // called from the TRDY irq, out of the driver locks, once the last byte of
+    // the segment is in the fifo. NULL if none
+    uart_sg_done_t done;
+    void* arg;
+} uart_sg;
 
 
 typedef struct {
@@ -29,6 +43,16 @@ typedef struct {
         size_t tail;
         uint8_t buf[UART_RX_BUF_SIZE];
     } rx;
+
+    // only used by the C side, after the buffers shared with the rust one.
+    // Drained by the TRDY handler once the tx buffer is empty
+    _Alignas(64) struct {
+        spinlock_t lock;
+        size_t head;
+        size_t tail;
+        size_t off; // bytes of the head segment already in the fifo
+        uart_sg seg[UART_TX_SG_LEN];
+    } sg;
 } uart_state;
 
 
@@ -63,6 +87,10 @@ void uart_handle_irq(const driver_handle* h);
 term_out_result uart_putc_sync(const driver_handle* h, const char c);
 term_out_result uart_putc(const driver_handle* h, const char c);
 
+/// Queues the n segments to be sent without copying them, after the bytes of
+/// the tx buffer. Returns false, queueing none, if they do not fit
+bool uart_write_sg(const driver_handle* h, const uart_sg* segs, size_t n);
+
 
 static inline size_t uart_tx_capacity()
 {
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ *  In kernel benchmark of the syscall round trip, the thread switch, the irq
+ *  entry/exit and a syscall that allocates with vmalloc, built with
+ *  CONFIG=bench. User threads time themselves with the el0 cycle counter (or
+ *  CNTVCT_EL0 with -DBENCH_CNTVCT) and the kernel prints the min/median/p99 of
+ *  each test on the uart when they end. The vmalloc test also checks that the
+ *  simd registers the thread keeps live across the syscall are left intact.
+ *  The sleep test runs a timed sleeper on two cores at once, and measures in
+ *  CNTVCT_EL0 ticks how late each wakes; an early wake fails it
+ */
+
+// x0 of SYSC_BENCH
+#define BENCH_OP_NULL 0    // returns right away
+#define BENCH_OP_TIMER 1   // arms the one shot timer of the irq test
+#define BENCH_OP_DONE 2    // the thread ended its test, it sleeps forever
+#define BENCH_OP_VMALLOC 3 // allocates and frees a page through vmalloc
+#define BENCH_OP_FAIL 4    // a check of the thread failed, panics
+
+// SYSC_BENCH and SYSC_SLEEP of kernel/syscall.h, for the asm of the user
+// threads
+#define BENCH_SYSC_NR 4
+#define BENCH_SLEEP_SYSC_NR 18
+
+// el1 physical timer, left free by the scheduler tick
+#define BENCH_TIMER_PPI 30
+#define BENCH_TIMER_DELAY_US 20
+
+// length of each sleep of the sleep test
+#define BENCH_SLEEP_US 500
+
+#ifdef BENCH_CNTVCT
+#    define BENCH_UNIT "ticks"
+#    define BENCH_IRQ_GAP 2 // a jump of the counter taken as an irq
+#else
+#    define BENCH_UNIT "cycles"
+#    define BENCH_IRQ_GAP 200
+#endif
+
+// timed per thread, plus the warmup dropped at both ends
+#define BENCH_SAMPLES 1024
+#define BENCH_WARMUP 64
+
+#ifndef __ASSEMBLER__
+#    include <stdint.h>
+
+/// Loads the bench task and starts the tests, a stage 2 initcall with BENCH
+void bench_start(void);
+
+/// Gives el0 the counters, every core running bench threads needs it
+void bench_cpu_init(void);
+
+/// x0: op, x1..x5: args of op
+int64_t sysc_bench(const uint64_t args[6]);
+#endif
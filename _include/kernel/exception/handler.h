@@ -6,4 +6,6 @@
 
 
 void exception_handler_irq();
+/// irq taken from el0, it can preempt the running thread
+void exception_handler_irq_lower(arm_exception_ctx* ectx);
 void exception_handler_sync(arm_exception_ctx* ectx);
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Lazy fp/simd switching. The el0 fp registers of a core belong to its fp
+ *  owner, the last thread that used them there. They are only saved when
+ *  another thread (or the kernel) needs them, and el0 traps on its first fp
+ *  instruction while it does not own them (CPACR_EL1.FPEN)
+ */
+
+struct thread;
+
+/// Saves the el0 fp state live in the core, so the kernel can use the simd
+/// registers. Must be called before any kernel simd code (lib/mem.h does it)
+void fpu_kernel_claim(void);
+
+/// Sets the el0 fp trap for th, about to run in the core
+void fpu_switch_to(struct thread* th);
+
+/// Handles the el0 fp trap of th, making it the fp owner of the core
+void fpu_handle_trap(struct thread* th);
+
+/// Returns the core where the fp state of th is live, or -1 if it is saved.
+/// A thread with live state must resume in that core
+int64_t fpu_live_core(const struct thread* th);
+
+/// Saves the fp state of th if it is live in the core, so th can resume in
+/// another one
+void fpu_release(struct thread* th);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 void io_early_init();
 void io_init();
 
@@ -16,6 +18,7 @@ void io_flush(io_out io);
 
 void fkprintf(io_out io, const char* s, ...);
 void fkprint(io_out io, const char* s);
+void fkwrite(io_out io, const char* buf, size_t n);
 
 
 #define kprintf(s, ...) fkprintf(IO_STDOUT, s, __VA_ARGS__)
@@ -39,6 +39,7 @@ void term_delete(term_handle* h);
  */
 void term_printc(term_handle* h, const char c);
 void term_prints(term_handle* h, const char* s);
+void term_write(term_handle* h, const char* buf, size_t n);
 void term_printf(term_handle* h, const char* s, va_list ap);
 
 
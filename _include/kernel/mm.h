@@ -13,8 +13,17 @@
 #    include <stdbool.h>
 #    include <stddef.h>
 #    include <stdint.h>
-#    define KPAGE_SIZE (MEM_KiB * 4ULL)
+// kernel page size and translation granule, set at build time with KPAGE_KiB
+#    ifndef KPAGE_KiB
+#        define KPAGE_KiB 4
+#    endif
+#    define KPAGE_SIZE (MEM_KiB * (uint64_t)KPAGE_KiB)
 #    define KPAGE_ALIGN KPAGE_SIZE
+#    define KPAGE_GRANULARITY ((mmu_granularity)KPAGE_SIZE)
+
+_Static_assert(
+    KPAGE_KiB == 4 || KPAGE_KiB == 16 || KPAGE_KiB == 64,
+    "KPAGE_KiB must be a translation granule (4, 16 or 64)");
 
 
 typedef enum {
@@ -108,7 +117,9 @@ typedef struct {
     bool device_mem;
     bool permanent;
     bool init_zeroed;
-    // TODO: add more cfgs if needed (for example mmu_cfg)
+    // memory type of the mapping. MMU_MT_NORMAL_WB (0) maps device_mem
+    // allocations as MMU_MT_DEVICE_NGNRE
+    mmu_memory_type mem_type;
 } raw_kmalloc_cfg;
 
 typedef struct {
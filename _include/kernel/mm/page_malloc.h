@@ -30,7 +30,18 @@ typedef struct {
 
 
 p_uintptr_t page_malloc(uint8_t order, mm_page_data p);
+/// frees the block allocated at pa. If pages of the block are still shared
+/// (page_ref) the block is freed by the last page_unref
 void page_free(p_uintptr_t pa);
+
+/// adds a shared mapping of the page at pa (any page of an allocated block).
+/// The mapping of the block owner is not counted
+void page_ref(p_uintptr_t pa);
+/// drops a shared mapping of the page at pa. Returns true if it freed the
+/// block (its owner had already freed it)
+bool page_unref(p_uintptr_t pa);
+/// shared mappings of the block that contains pa
+uint32_t page_refs(p_uintptr_t pa);
 const char* page_allocator_update_tag(p_uintptr_t pa, const char* new_tag);
 
 // copies the data from the page to the provided address
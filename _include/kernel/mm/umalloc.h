@@ -58,7 +58,66 @@ void* umalloc(
     // be assigned without need for waiting for data aborts
     bool permanent);
 
+/// assigns zeroed pages to [usr_va, usr_va + pages * page) of a lazy region,
+/// returns their kernel va
 void* umalloc_assign_pa(struct utask* t, uintptr_t usr_va, uint32_t pages);
 
+/// maps the page at pa, of an allocated block, at usr_va of a lazy region of t
+/// without copying it. The block is kept until t unmaps it (page_ref). If the
+/// region is writable the page is copied on the first write
+void umalloc_share_pa(struct utask* t, uintptr_t usr_va, p_uintptr_t pa);
 
+// pages assigned by a translation fault, from the faulting one on
+#ifndef UMALLOC_FAULT_AROUND
+#    define UMALLOC_FAULT_AROUND 4
+#endif
+
+/// Handles an EL0 translation fault at usr_va of t, assigning its page (and the
+/// unmapped ones after it, up to UMALLOC_FAULT_AROUND) if it is inside a region
+/// that allows the access. Returns false if it is not. Takes t->lock
+bool umalloc_handle_translation_fault(
+    struct utask* t,
+    uintptr_t usr_va,
+    bool write,
+    bool execute);
+
+
+/// frees the region of t that starts at usr_va, with the pages it owns
 void ufree(struct utask* t, uintptr_t usr_va);
+
+/// true if any region of t overlaps [usr_va, usr_va + size)
+bool umalloc_region_exists(struct utask* t, uintptr_t usr_va, size_t size);
+
+/// true if t has a region that is exactly [usr_va, usr_va + pages * page)
+bool umalloc_region_is(struct utask* t, uintptr_t usr_va, uint32_t pages);
+
+/// changes the access of the region of t that is exactly [usr_va, usr_va +
+/// pages * page). Returns false if there is none. R, RW and RX are supported
+bool umalloc_protect(
+    struct utask* t,
+    uintptr_t usr_va,
+    uint32_t pages,
+    bool read,
+    bool write,
+    bool execute);
+
+
+/// Copies the regions of src into dst (which must have none) sharing their
+/// mapped pages. Writable pages are write protected in both tasks and copied
+/// on the first write (umalloc_handle_write_fault)
+void umalloc_clone_cow(struct utask* dst, struct utask* src);
+
+/// Handles an EL0 write permission fault at usr_va of t, which must be the
+/// task of the active mapping. Returns false if the page is not copy on write
+bool umalloc_handle_write_fault(struct utask* t, uintptr_t usr_va);
+
+
+/// true if every byte of [usr_va, usr_va + size) is mapped readable for el0 in
+/// t, so the kernel can read it through the user va while t is active. The lazy
+/// pages of the range are assigned
+bool umalloc_user_readable(struct utask* t, uintptr_t usr_va, size_t size);
+
+/// Kernel va of the byte at usr_va of t through the kernel access of its
+/// region, valid while any task maps it. NULL if the page has no kernel access
+/// of t, like the pages shared by a clone or not assigned yet
+void* umalloc_user_kva(struct utask* t, uintptr_t usr_va);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <arm/mmu.h>
 #include <lib/mem.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -12,6 +13,7 @@ typedef struct {
     bool assing_pa;
     bool device_mem;
     bool permanent;
+    mmu_memory_type mem_type;
 } vmalloc_cfg;
 
 typedef struct {
@@ -20,6 +22,7 @@ typedef struct {
     bool pa_assigned;
     bool device_mem;
     bool permanent;
+    mmu_memory_type mem_type;
 } vmalloc_allocated_area_mdt;
 
 
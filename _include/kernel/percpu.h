@@ -0,0 +1,59 @@
+#pragma once
+
+#include <kernel/hardware.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Per core data. DEFINE_PER_CPU places a variable in the .percpu section of
+ *  linker.ld, which holds the copy of core 0 followed by the one of each other
+ *  core. TPIDR_EL1 holds the offset from the copy of core 0 to the one of the
+ *  running core, so this_cpu_ptr is a mrs and an add away from the variable.
+ *  Before percpu_init_cpu every core uses the copy of core 0
+ */
+
+#define DEFINE_PER_CPU(T, name) __attribute__((section(".percpu"))) T name
+
+extern char __percpu_start[];
+extern char __percpu_end[];
+
+#define PERCPU_SIZE ((uintptr_t)(__percpu_end - __percpu_start))
+
+
+static inline uintptr_t percpu_offset(void)
+{
+    uintptr_t off;
+
+    // not volatile, the offset of a core never changes once set. The memory
+    // input keeps it after the msr of percpu_init_cpu, whose memory clobber
+    // writes it
+    asm("mrs %0, tpidr_el1" : "=r"(off) : "m"(*__percpu_start));
+
+    return off;
+}
+
+
+/// copy of var of core
+#define per_cpu_ptr(var, core) \
+    ((__typeof__(&(var)))((uintptr_t)&(var) + (core) * PERCPU_SIZE))
+
+/// copy of var of the running core
+#define this_cpu_ptr(var) \
+    ((__typeof__(&(var)))((uintptr_t)&(var) + percpu_offset()))
+
+#define this_cpu_read(var) (*this_cpu_ptr(var))
+#define this_cpu_write(var, val) (*this_cpu_ptr(var) = (val))
+
+
+extern DEFINE_PER_CPU(size_t, cpu_number);
+
+/// index of the running core, Aff0 of MPIDR_EL1 without reading it
+static inline size_t this_cpu_id(void)
+{
+    return this_cpu_read(cpu_number);
+}
+
+
+/// Points TPIDR_EL1 to the per core data of core. Core 0 also fills the copies
+/// of the other cores, so it must run it before they start
+void percpu_init_cpu(size_t core);
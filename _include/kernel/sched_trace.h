@@ -0,0 +1,37 @@
+#pragma once
+
+#include <kernel/io/stdio.h>
+#include <stdint.h>
+
+/*
+ *  Trace of the scheduler events. Each core keeps the last SCHED_TRACE_LEN
+ *  events it recorded in its own ring, written with irqs masked and without
+ *  locks, so tracing is always on
+ */
+
+#ifndef SCHED_TRACE_LEN
+#    define SCHED_TRACE_LEN 256 // power of 2
+#endif
+
+typedef enum {
+    SCHED_TRACE_SWITCH,  // th: previous thread (0 if idle), arg: next one
+    SCHED_TRACE_WAKEUP,  // th: woken thread, arg: core it was queued on
+    SCHED_TRACE_MIGRATE, // th: migrated thread, arg: core of its last run
+} sched_trace_event;
+
+typedef struct {
+    uint64_t ts; // cycles
+    uint64_t th; // th_uid
+    uint64_t arg;
+    uint32_t event;
+    uint32_t _pad;
+} sched_trace_entry;
+
+
+/// Records an event in the ring of the core
+void sched_trace(sched_trace_event event, uint64_t th, uint64_t arg);
+
+/// Prints the rings of every core to io, oldest event first. The rings of
+/// running cores can change while they are printed. Called by the bench report
+/// and by panic
+void sched_trace_dump(io_out io);
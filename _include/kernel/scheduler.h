@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include <arm/fpu.h>
 #include <arm/mmu.h>
 #include <kernel/hardware.h>
 #include <kernel/mm/umalloc.h>
@@ -12,6 +13,27 @@
 #include "arm/exceptions/exceptions.h"
 #include "kernel/lib/kvec.h"
 
+// sgi that wakes an idle core when a thread is queued on it
+#define SCHED_WAKE_SGI 1
+
+// virtual timer ppi of each core, programmed by the scheduler for its tick
+#define SCHED_TICK_PPI 27
+
+// thread priorities. 0 is the best effort class, round robin with a quantum.
+// 1..SCHED_RT_PRIOS - 1 are the fixed real time priorities, higher is more
+// urgent. A ready rt thread always runs before any less urgent one
+#define SCHED_PRIO_BE 0
+#define SCHED_RT_PRIOS 32
+
+// affinity mask with every core allowed, bit i is core i
+#define SCHED_AFFINITY_ALL ((uint32_t)((1U << NUM_CORES) - 1))
+
+// length of the time slice of a thread before it is preempted
+#ifndef SCHED_QUANTUM_US
+#    define SCHED_QUANTUM_US 10000
+#endif
+
+
 void scheduler_loop_cpu_enter();
 void scheduler_loop_cpu_exit();
 
@@ -19,9 +41,61 @@ void scheduler_loop_cpu_exit();
 void scheduler_ectx_save(arm_exception_ctx* ectx);
 void schedurer_ectx_restore(arm_exception_ctx* ectx);
 
+/// Saves the interrupted thread on an irq taken from el0
+void scheduler_irq_enter(arm_exception_ctx* ectx);
+
+/// Resumes the interrupted thread, or switches to the next one if its quantum
+/// expired while handling the irq
+void scheduler_irq_exit(arm_exception_ctx* ectx);
+
+/// Handler of SCHED_TICK_PPI, wakes the due sleepers and expires the quantum
+/// of the running core
+void scheduler_timer_irq();
+
+
+typedef struct {
+    uint64_t ticks;       // expired quanta
+    uint64_t preemptions; // switches caused by an expired quantum
+    // time from the expiration of the quantum to the switch
+    uint64_t lat_min_ns;
+    uint64_t lat_max_ns;
+    uint64_t lat_sum_ns;
+    // rt class, from the wakeup to the start of the run
+    uint64_t rt_wakeups;
+    uint64_t rt_lat_max_ns;
+    uint64_t rt_lat_sum_ns;
+} scheduler_stats;
+
+/// Sets the quantum of the threads, applied from the next tick of each core
+void scheduler_set_quantum_us(uint64_t us);
+
+scheduler_stats scheduler_get_stats(size_t core);
+
+/// prints the stats of every core
+void scheduler_print_stats();
+
+/// prints the accounting of every thread of t
+void scheduler_print_task(struct utask* t);
+
+
+/// returns the thread running in the cpu. Only valid while handling an
+/// exception taken from el0
+struct thread* scheduler_current_thread();
+
+/// returns the user task of the thread running in the cpu. Only valid while
+/// handling an exception taken from el0
+struct utask* scheduler_current_utask();
+
+/// true if the core has a ready thread, or a preemption pending, that a switch
+/// at this point would run. Lockless, it can change right after
+bool scheduler_local_has_ready();
+
 
 /* --- Tasks --- */
 
+// start of the vas handed out by SYSC_MAP, over the ones placed by the loader
+#define UTASK_MAP_BASE 0x100000000ULL
+
 typedef struct usr_region_node {
     struct usr_region_node* next;
     usr_region region;
@@ -36,9 +110,23 @@ typedef struct utask {
     mmu_mapping mapping;
     usr_region_node* regions;
     kvec_T(thread*) threads;
+
+    uintptr_t map_next;           // lowest free va for SYSC_MAP
+    struct sysc_ring_state* ring; // NULL until SYSC_RING_SETUP
+    // zero copy writes the uart has not finished, their pages can not be
+    // unmapped until then
+    uint32_t zc_writes;
 } utask;
 
 
+/// Creates a new task named name with an empty address space
+utask* utask_new(const char* name);
+
+/// Creates a new task named name with a copy on write clone of the address
+/// space of src. The threads are not cloned
+utask* utask_clone(utask* src, const char* name);
+
+
 typedef struct {
     uint64_t task_uid;
     const char* task_name;
@@ -59,11 +147,24 @@ typedef enum {
 typedef enum {
     THREAD_NEW,
     THREAD_READY,
+    THREAD_PICKED, // taken off a run queue by a core, about to run there
     THREAD_RUNNING,
     THREAD_SLEEPING,
     THREAD_DEAD,
 } thread_state;
 
+/// Scheduler accounting of a thread, updated by the core that switches it
+typedef struct {
+    uint64_t run;            // cycles running, in el0 and in its syscalls
+    uint64_t wait;           // cycles ready in a run queue
+    uint64_t since;          // cycles, start of the current run or wait
+    uint32_t nr_voluntary;   // switches by going to sleep
+    uint32_t nr_involuntary; // switches while runnable
+    uint32_t nr_migrations;  // runs in a core other than the one before
+    uint32_t last_cpu;       // core of the last run, UINT32_MAX before it
+} thread_acct;
+
+
 typedef struct thread {
     uint64_t th_uid;
 
@@ -76,6 +177,62 @@ typedef struct thread {
     uint64_t pc;
     arm_exception_ctx ctx;
 
-    uint64_t last_access_time_us;
+    thread_acct acct;
     uint32_t th_flags;
+
+    thread_state state;
+    uint32_t cpu; // core of the last run
+
+    arm_fp_ctx fp; // saved by kernel/fpu.h when the thread loses the registers
+
+    uint64_t wake_at;          // cycles, deadline of a timed sleep
+    struct thread* timer_next; // next timed sleeper of the core
+
+    struct thread* wq_next; // next sleeper of its wait queue
+    uintptr_t wait_key;     // key of the wait queue sleep
+
+    uint8_t prio;      // effective priority, base_prio or an inherited one
+    uint8_t base_prio; // priority set by scheduler_set_priority
+    uint64_t ready_at; // cycles, when it was woken. 0 if requeued
+
+    uint32_t affinity;   // cores it may run on, SCHED_AFFINITY_ALL by default
+    uint32_t migrate_to; // core + 1 requested by thread_migrate, 0 if none
 } thread;
+
+
+/// Creates a user thread of t starting at pc with the stack sp and arg in x0,
+/// and queues it in the least loaded core
+thread* scheduler_thread_new(utask* t, uint64_t pc, uint64_t sp, uint64_t arg);
+
+/// Marks the running thread as sleeping, it is not queued again when the core
+/// switches to the next thread
+void scheduler_sleep_current();
+
+/// Sleeps the running thread until the generic timer counter reaches wake_at.
+/// The core programs the comparator for it, also while idle
+void scheduler_sleep_until(uint64_t wake_at);
+
+/// Queues a sleeping thread, waking an idle core if needed
+void scheduler_wake(thread* th);
+
+/// Sets the base priority of th (SCHED_PRIO_BE or a rt priority)
+void scheduler_set_priority(thread* th, uint8_t prio);
+
+/// Priority inheritance for sleeping locks: the owner of a lock runs at least
+/// at the priority of the most urgent waiter until it is released. Spinlocks do
+/// not need it, they are held with irqs masked and are never preempted
+void scheduler_pi_boost(thread* owner, uint8_t prio);
+
+/// Drops the inherited priority of owner back to its base priority. The boosts
+/// are not tracked per lock: an owner that still holds another pi lock with
+/// waiters loses their boost too, until one of them boosts it again by sleeping
+/// on it. Only a single contended pi lock per thread keeps its bound
+void scheduler_pi_restore(thread* owner);
+
+/// Restricts th to the cores of mask. A thread running or queued in a core
+/// out of the mask is moved at its next switch there
+void scheduler_set_affinity(thread* th, uint32_t mask);
+
+/// Moves th to core, which must be in its affinity mask. Balancing does not
+/// take it elsewhere until it has run there
+void thread_migrate(thread* th, size_t core);
@@ -1,19 +1,174 @@
 #pragma once
 
 #include <arm/exceptions/exceptions.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+
+// the number goes in x8, the args in x0..x5 and the result is returned in x0
 typedef enum {
     SYSC_PRINT = 0,
+    SYSC_MAP = 1,
+    SYSC_FUTEX_WAIT = 2,
+    SYSC_FUTEX_WAKE = 3,
+    SYSC_BENCH = 4, // only with CONFIG=bench, see kernel/bench.h
+    SYSC_GETPID = 5,
+    SYSC_GETTID = 6,
+    SYSC_CLOCK = 7,
+    SYSC_YIELD = 8,
+    SYSC_RING_SETUP = 9,
+    SYSC_RING_ENTER = 10,
+    SYSC_WRITE = 11,
+    SYSC_MMAP = 12,
+    SYSC_MUNMAP = 13,
+    SYSC_MPROTECT = 14,
+    SYSC_SET_PRIORITY = 15,
+    SYSC_FUTEX_LOCK_PI = 16,
+    SYSC_FUTEX_UNLOCK_PI = 17,
+    SYSC_SLEEP = 18,
+    SYSC_CLOCK_SETTIME = 19,
 
     SYSC_COUNT,
 } syscall;
 
 
+typedef enum {
+    SYSC_ERR_NOSYS = -1, // no syscall with that number
+    SYSC_ERR_AGAIN = -2,
+    SYSC_ERR_FAULT = -3, // a pointer arg out of the user address space
+    SYSC_ERR_INVAL = -4, // an arg out of the range of its kind
+    SYSC_ERR_NOMEM = -5, // the kernel could not allocate the memory
+} sysc_results;
+
+typedef enum {
+    SYSC_FUTEX_OK = 0,
+    SYSC_FUTEX_AGAIN = SYSC_ERR_AGAIN, // *uaddr != val when going to sleep
+    SYSC_FUTEX_FAULT = SYSC_ERR_FAULT, // uaddr unaligned or not mapped
+} sysc_futex_results;
+
+// word of a priority inheritance futex: the tid of the owner, 0 if unlocked,
+// and a bit set by the kernel while threads sleep on it
+#define SYSC_FUTEX_TID_MASK 0x3FFFFFFFU
+#define SYSC_FUTEX_WAITERS 0x80000000U
+
+
+// clocks of SYSC_CLOCK_SETTIME, the clockid_t of the stl
+#define SYSC_CLOCK_REALTIME 0
+
+
+// prot of SYSC_MMAP and SYSC_MPROTECT, one of R, RW or RX
+#define SYSC_PROT_READ 1
+#define SYSC_PROT_WRITE 2
+#define SYSC_PROT_EXEC 4
+
+// returned by a handler that already stored its result in the thread context,
+// as it went to sleep and could be running elsewhere after it
+#define SYSC_RESULT_STORED INT64_MIN
+
+// returned by a fast handler that needs the slow path, see syscall_desc
+#define SYSC_RESULT_SLOW (INT64_MIN + 1)
+
 typedef int64_t (*syscall_handler)(const uint64_t args[6]);
 
 
-static inline void sysc64_dispatch(arm_exception_ctx* ectx)
-{
-    (void)ectx;
-};
+// kind of each arg, checked before the handler runs
+typedef enum {
+    SYSC_ARG_NONE = 0, // unused, the handler sees 0
+    SYSC_ARG_U64,
+    SYSC_ARG_U32,  // SYSC_ERR_INVAL if it does not fit in 32 bits
+    SYSC_ARG_UPTR, // SYSC_ERR_FAULT if it is not a user address
+} syscall_arg;
+
+/*
+ *  Entry of the syscall table. fast runs on the exception frame, before the
+ *  thread is saved: it can only read registers and per core state, and must
+ *  not sleep or switch. It returns SYSC_RESULT_SLOW to fall back to fn, which
+ *  runs with the thread saved and is followed by a scheduling point
+ */
+typedef struct {
+    syscall_handler fn;
+    syscall_handler fast;
+    uint8_t args[6]; // syscall_arg
+    bool batch;      // allowed in a syscall ring, fn must not sleep
+} syscall_desc;
+
+
+/// Runs the syscall of the exception frame if it has a fast handler that
+/// completes it, storing the result in ectx. Returns false if the syscall needs
+/// sysc64_dispatch
+bool sysc64_fast(arm_exception_ctx* ectx);
+
+/// Runs the syscall of the thread saved by scheduler_ectx_save, storing the
+/// result in its context
+void sysc64_dispatch(arm_exception_ctx* ectx);
+
+/// Runs the syscall nr with the args of a ring entry, from the thread saved by
+/// scheduler_ectx_save. Returns its result, SYSC_ERR_INVAL if it is not batch
+int64_t sysc_run_batched(uint64_t nr, const uint64_t args[6]);
+
+
+/// x0: buf, x1: size. Writes size bytes of buf to the uart
+int64_t sysc_print(const uint64_t args[6]);
+
+/// x0: buf, x1: size. Like SYSC_PRINT, but a big buffer is sent by the uart
+/// straight from the pages of the task, sleeping until it is. Returns size
+int64_t sysc_write(const uint64_t args[6]);
+
+/// x0: pages. Maps pages zeroed rw pages in the task, returns their va,
+/// SYSC_ERR_INVAL if they do not fit under the vtime page or SYSC_ERR_NOMEM
+int64_t sysc_map(const uint64_t args[6]);
+
+/// Places pages rw pages at the next free va of t, with t->lock held. Returns
+/// their va and stores their kernel va in kva, or an error like SYSC_MAP. The
+/// pages are not zeroed
+struct utask;
+int64_t sysc_map_locked(struct utask* t, uint32_t pages, void** kva);
+
+/// x0: addr, x1: len, x2: prot. Reserves len bytes of zeroed pages at addr (at
+/// a free va if it is 0), each one assigned on its first access. Returns the va
+int64_t sysc_mmap(const uint64_t args[6]);
+
+/// x0: addr, x1: len. Unmaps and frees a whole SYSC_MMAP or SYSC_MAP region.
+/// SYSC_ERR_AGAIN while a zero copy SYSC_WRITE of the task is in flight
+int64_t sysc_munmap(const uint64_t args[6]);
+
+/// x0: addr, x1: len, x2: prot. Changes the access of a whole region
+int64_t sysc_mprotect(const uint64_t args[6]);
+
+/// x0: uaddr, x1: val. Sleeps while the u32 at uaddr is val
+int64_t sysc_futex_wait(const uint64_t args[6]);
+
+/// x0: uaddr, x1: n. Wakes up to n threads waiting on uaddr, returns how many
+int64_t sysc_futex_wake(const uint64_t args[6]);
+
+/// x0: uaddr. Takes the pi futex at uaddr, sleeping while another thread owns
+/// it. The owner runs at least at the priority of the thread until it unlocks
+int64_t sysc_futex_lock_pi(const uint64_t args[6]);
+
+/// x0: uaddr. Releases the pi futex at uaddr, owned by the thread, handing it
+/// to its most urgent waiter. Drops the priority inherited while it was held
+int64_t sysc_futex_unlock_pi(const uint64_t args[6]);
+
+/// Returns the uid of the task of the thread
+int64_t sysc_getpid(const uint64_t args[6]);
+
+/// Returns the uid of the thread
+int64_t sysc_gettid(const uint64_t args[6]);
+
+/// Returns the monotonic time in ns
+int64_t sysc_clock(const uint64_t args[6]);
+
+/// x0: clk, x1: ns. Sets clk to ns since the epoch. Only SYSC_CLOCK_REALTIME
+/// can be set, the monotonic clock is the counter
+int64_t sysc_clock_settime(const uint64_t args[6]);
+
+/// x0: prio. Sets the base priority of the thread, SCHED_PRIO_BE or a rt one
+int64_t sysc_set_priority(const uint64_t args[6]);
+
+/// Gives the core to the next ready thread. Fast if there is none
+int64_t sysc_yield_fast(const uint64_t args[6]);
+int64_t sysc_yield(const uint64_t args[6]);
+
+/// x0: ns. Sleeps the thread for at least ns, woken by the timer of its core.
+/// Like SYSC_YIELD if it is 0
+int64_t sysc_sleep(const uint64_t args[6]);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ *  Syscall rings: a task posts syscalls to a submission queue in memory shared
+ *  with the kernel, and SYSC_RING_ENTER runs a batch of them in one exception,
+ *  writing each result to the completion queue. Only the syscalls marked batch
+ *  in the syscall table can be posted, the others complete with
+ *  SYSC_ERR_INVAL. The layout is shared with the stl
+ *  (userspace/stl/include/ring.h)
+ *
+ *  The user owns sq_tail and cq_head, the kernel sq_head and cq_tail. The
+ *  kernel keeps its own copy of its indices and of the size, and only trusts
+ *  the ones of the user after checking them. The kernel writes the ring
+ *  through its own va, so utask_clone (which write protects the regions of the
+ *  source) must not be used on a task with a ring
+ */
+
+#define SYSC_RING_MAX_ENTRIES 4096 // power of 2
+
+typedef struct {
+    uint64_t user_data; // copied to the completion
+    uint32_t nr;        // syscall number
+    uint32_t _pad;
+    uint64_t args[6];
+} sysc_sqe;
+
+typedef struct {
+    uint64_t user_data;
+    int64_t result;
+} sysc_cqe;
+
+typedef struct sysc_ring {
+    uint32_t sq_head;
+    uint32_t sq_tail;
+    uint32_t cq_head;
+    uint32_t cq_tail;
+    uint32_t entries; // of each queue
+    uint32_t _pad;
+    uint64_t sq_off; // from the start of the ring, sysc_sqe[entries]
+    uint64_t cq_off; // sysc_cqe[entries]
+} sysc_ring;
+
+// header, then the sq and the cq
+#define SYSC_RING_SQ_OFF 64
+#define SYSC_RING_BYTES(entries) \
+    (SYSC_RING_SQ_OFF +          \
+     (uint64_t)(entries) * (sizeof(sysc_sqe) + sizeof(sysc_cqe)))
+
+
+// kernel side of the ring of a task
+typedef struct sysc_ring_state {
+    sysc_ring* shared; // kernel va of the ring
+    uint32_t entries;
+    uint32_t sq_head;
+    uint32_t cq_tail;
+    uint32_t busy; // a thread of the task is running the ring
+} sysc_ring_state;
+
+
+/// x0: entries. Maps a ring with entries sqes and cqes (a power of 2 up to
+/// SYSC_RING_MAX_ENTRIES) in the task, returns its user va. One per task,
+/// SYSC_ERR_AGAIN if it already has one. Placed like SYSC_MAP
+int64_t sysc_ring_setup(const uint64_t args[6]);
+
+/// x0: n. Runs up to n pending sqes, fewer if the cq fills up, returns how
+/// many ran
+int64_t sysc_ring_enter(const uint64_t args[6]);
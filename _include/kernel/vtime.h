@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+struct utask;
+
+/*
+ *  Time page, mapped read only at VTIME_USR_VA in every user task. El0 reads
+ *  CNTVCT_EL0 (the counter of the kernel clock, CNTVOFF_EL2 is 0) and converts
+ *  it with the page, so reading the time does not trap. The layout is shared
+ *  with the stl (userspace/stl/include/time.h)
+ */
+
+// last 64KiB of the user address space, aligned for every KPAGE_KiB
+#define VTIME_USR_VA 0xFFFFFFFF0000ULL
+
+// ns = (cnt * mult) >> shift, computed in 128 bits
+#define VTIME_SHIFT 32
+
+typedef struct {
+    // odd while the kernel writes the page. Readers retry if it was odd or
+    // changed while they read
+    uint32_t seq;
+    uint32_t shift;
+    uint64_t mult;
+    uint64_t freq;        // counter ticks per second
+    uint64_t realtime_ns; // CLOCK_REALTIME - CLOCK_MONOTONIC
+} vtime_data;
+
+
+/// Gives el0 access to the virtual counter, every core that runs user threads
+/// needs it
+void vtime_cpu_init(void);
+
+/// Maps the time page into t
+void vtime_map(struct utask* t);
+
+/// Sets CLOCK_REALTIME to ns since the epoch, for SYSC_CLOCK_SETTIME
+void vtime_set_realtime(uint64_t ns);
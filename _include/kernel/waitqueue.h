@@ -0,0 +1,38 @@
+#pragma once
+
+#include <lib/lock/spinlock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+
+/// Fifo of sleeping threads, linked through thread.wq_next
+typedef struct {
+    spinlock_t lock;
+    struct thread* head;
+    struct thread* tail;
+} wait_queue;
+
+#define WAIT_QUEUE_INIT {.lock = SPINLOCK_INIT, .head = NULL, .tail = NULL}
+
+
+/// Sleeps the running thread at the tail of wq tagged with key. wq->lock must
+/// be held, so the condition can be checked atomically with the sleep. The core
+/// switches to another thread on the exit of the exception, and a wake can
+/// queue the thread again before that
+void wait_queue_sleep_locked(wait_queue* wq, uintptr_t key);
+
+/// Wakes up to n threads of wq from the head whose key is key. Returns the
+/// number of woken threads
+size_t wait_queue_wake(wait_queue* wq, uintptr_t key, size_t n);
+
+/// Takes the most urgent thread of wq sleeping with key, the first one of the
+/// highest priority, without waking it. NULL if there is none. wq->lock must be
+/// held
+struct thread* wait_queue_pop_locked(wait_queue* wq, uintptr_t key);
+
+/// Highest priority of the threads of wq sleeping with key, -1 if there is
+/// none. wq->lock must be held
+int32_t wait_queue_top_prio_locked(const wait_queue* wq, uintptr_t key);
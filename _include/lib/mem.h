@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "kernel/fpu.h"
 #include "kernel/panic.h"
 
 // phys address uintptr_t
@@ -90,13 +91,18 @@ static inline v_uintptr_t va_zero_extend(v_uintptr_t va, size_t bits)
  *  Mem ctrl fns
  */
 
-// TODO: maybe doing a c wrapper makes sense for checking if simd is enabled at
-// lower EL levels
-#define memcpy(dst, src, size) _memcpy(dst, src, size)
-
 /// Standard memcpy, requieres simd instructions to be enabled
 extern void* _memcpy(void* dst, const void* src, size_t size);
 
+// host builds of the table code (tools/mmu_sim) define it to use the libc one
+#ifndef MEM_HOST_LIBC
+static inline void* memcpy(void* dst, const void* src, size_t size)
+{
+    fpu_kernel_claim();
+    return _memcpy(dst, src, size);
+}
+#endif
+
 /// Panics: if the size is not divisible by 64
 void* memcpy64(void* dst, const void* src, size_t size);
 
@@ -118,5 +124,19 @@ extern void* _memzero(void* dst, size_t size);
 extern void* _memzero64(void* dst16, size_t size64);
 
 
-#define memzero(dst, size) _memzero(dst, size)
-#define memzero64(dst, size) _memzero64(dst, size)
+/// Byte fill with the general registers only, the target of the memset calls
+/// emitted by gcc. Needs no fpu_kernel_claim
+void* memset(void* dst, int c, size_t size);
+
+
+static inline void* memzero(void* dst, size_t size)
+{
+    fpu_kernel_claim();
+    return _memzero(dst, size);
+}
+
+static inline void* memzero64(void* dst16, size_t size64)
+{
+    fpu_kernel_claim();
+    return _memzero64(dst16, size64);
+}
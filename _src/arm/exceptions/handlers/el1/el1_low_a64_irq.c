@@ -1,7 +1,7 @@
 #include <kernel/exception/handler.h>
 
 
-void el1_low_a64_irq_handler(void)
+void el1_low_a64_irq_handler(arm_exception_ctx* ectx)
 {
-    exception_handler_irq();
+    exception_handler_irq_lower(ectx);
 }
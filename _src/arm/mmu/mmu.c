@@ -44,9 +44,13 @@ is_in_range(const mmu_mapping* m, v_uintptr_t va, size_t size)
 }
 
 
+/// finds the biggest level that can translate the start of the range. If a
+/// full aligned contiguous-hint run fits, entries is the run length and cover
+/// the bytes of the whole run
 static inline void get_target_lvl(
     mmu_tbl_level* target_lvl,
     size_t* cover,
+    size_t* entries,
     size_t size,
     mmu_granularity g,
     v_uintptr_t va,
@@ -58,14 +62,143 @@ static inline void get_target_lvl(
     for (l = MMU_TBL_LV1; l <= max_level(g); l++) {
         c = dc_cover_bytes(g, l);
 
+        if (l < max_level(g) && !lvl_has_blocks(g, l))
+            continue;
+
         if (size >= dc_cover_bytes(g, l) && va % c == 0 && pa % c == 0)
             break;
     }
 
+    size_t n = contig_entries(g, l);
+    size_t run = n * c;
+
+    if (n == 1 || size < run || va % run != 0 || pa % run != 0)
+        n = 1;
+
     if (target_lvl)
         *target_lvl = l;
     if (cover)
-        *cover = c;
+        *cover = n * c;
+    if (entries)
+        *entries = n;
+}
+
+
+/// frees the tables of path, from level l upwards, that have become fully null
+/// after an unmap of va. The root table is owned by the mapping and is never
+/// freed
+static void reclaim_null_tbls(
+    const mmu_mapping* m,
+    mmu_tbl* path,
+    mmu_tbl_level l,
+    v_uintptr_t va,
+    mmu_op_info* info)
+{
+    const mmu_granularity g = m->g_;
+    const mmu_tbl_level deepest = l;
+
+    // unlinking a table can leave its parent null too
+    for (; l > MMU_TBL_LV0; l--) {
+        if (!tbl_is_null(path[l], g))
+            break;
+
+        path[l - 1].dcs[table_index(va, g, l - 1)] = NULL_PD;
+    }
+
+    if (l == deepest)
+        return;
+
+    // the unlinked tables could still be cached by the walker
+    MMU_APPLY_CHANGES();
+
+    for (mmu_tbl_level freed = deepest; freed > l; freed--)
+        free_tbl(m, path[freed], freed, info);
+}
+
+
+static inline void walk_cache_invalidate(mmu_mapping* m)
+{
+    __atomic_add_fetch(&m->walk_cache_.gen, 1, __ATOMIC_RELEASE);
+}
+
+
+/// returns the deepest cached table that translates va (or the root table),
+/// and its level
+static mmu_tbl walk_cache_lookup(
+    mmu_mapping* m,
+    uint64_t gen,
+    v_uintptr_t va,
+    mmu_tbl_level* l)
+{
+    for (size_t i = 0; i < MMU_WALK_CACHE_ENTRIES; i++) {
+        mmu_walk_cache_entry* e = &m->walk_cache_.entries[i];
+
+        const uint64_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1)
+            continue;
+
+        const uint64_t e_gen = __atomic_load_n(&e->gen, __ATOMIC_RELAXED);
+        const v_uintptr_t base = __atomic_load_n(&e->va_base, __ATOMIC_RELAXED);
+        void* const tbl = __atomic_load_n(&e->tbl, __ATOMIC_RELAXED);
+        const size_t lvl = __atomic_load_n(&e->lvl, __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq || e_gen != gen)
+            continue;
+
+        if ((va & ~(dc_cover_bytes(m->g_, lvl - 1) - 1)) != base)
+            continue;
+
+        *l = lvl;
+        return (mmu_tbl) {.dcs = tbl};
+    }
+
+    *l = MMU_TBL_LV0;
+    return mmu_mapping_get_tbl(m);
+}
+
+
+/// gen must be read before walking to tbl, so a concurrent op leaves the entry
+/// stale
+static void walk_cache_fill(
+    mmu_mapping* m,
+    uint64_t gen,
+    v_uintptr_t va,
+    mmu_tbl tbl,
+    mmu_tbl_level l)
+{
+    mmu_walk_cache* c = &m->walk_cache_;
+
+    if (l == MMU_TBL_LV0)
+        return;
+
+    const size_t i = __atomic_fetch_add(&c->next, 1, __ATOMIC_RELAXED) %
+                     MMU_WALK_CACHE_ENTRIES;
+    mmu_walk_cache_entry* e = &c->entries[i];
+
+    // another writer owns the entry, just skip the fill
+    uint64_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if ((seq & 1) ||
+        !__atomic_compare_exchange_n(
+            &e->seq,
+            &seq,
+            seq + 1,
+            false,
+            __ATOMIC_ACQUIRE,
+            __ATOMIC_RELAXED))
+        return;
+
+    __atomic_store_n(&e->gen, gen, __ATOMIC_RELAXED);
+    __atomic_store_n(
+        &e->va_base,
+        va & ~(dc_cover_bytes(m->g_, l - 1) - 1),
+        __ATOMIC_RELAXED);
+    __atomic_store_n(&e->tbl, tbl.dcs, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->lvl, (size_t)l, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
 }
 
 
@@ -76,7 +209,7 @@ bool mmu_is_active()
 
 
 mmu_map_result mmu_map(
-    const mmu_mapping* m,
+    mmu_mapping* m,
     v_uintptr_t va,
     p_uintptr_t pa,
     size_t size,
@@ -85,7 +218,7 @@ mmu_map_result mmu_map(
 {
     mmu_granularity g = m->g_;
     mmu_tbl_level target_lvl;
-    size_t cover;
+    size_t cover, entries;
 
     if (!m)
         return MMU_MAP_NULL_MAPPING;
@@ -109,7 +242,7 @@ mmu_map_result mmu_map(
 
         ASSERT(size % g == 0 && va % g == 0 && pa % g == 0);
 
-        get_target_lvl(&target_lvl, &cover, size, g, va, pa);
+        get_target_lvl(&target_lvl, &cover, &entries, size, g, va, pa);
 
         DEBUG_ASSERT(va % cover == 0);
         DEBUG_ASSERT(pa % cover == 0);
@@ -138,7 +271,7 @@ mmu_map_result mmu_map(
 
             switch (dc_get_type(descriptor, g, l)) {
                 case MMU_DESCRIPTOR_BLOCK:
-                    tbl = split_block(m, tbl, i, l, info);
+                    tbl = split_block(m, tbl, i, l, va, info);
                     continue;
                 case MMU_DESCRIPTOR_TABLE:
                     tbl = tbl_from_td(m, descriptor, l);
@@ -149,17 +282,31 @@ mmu_map_result mmu_map(
             }
         }
 
-        // build the block descriptor
+        // build the block descriptors
         i = table_index(va, g, target_lvl);
 
-        mmu_hw_dc old = mmu_tbl_get_dc(tbl, i, g);
+        // a single entry can not be replaced inside a contiguous run
+        if (entries == 1 && dc_get_contiguous(mmu_tbl_get_dc(tbl, i, g)))
+            unfold_contig(tbl, i, g, target_lvl);
+
+        for (size_t k = 0; k < entries; k++) {
+            const size_t c = dc_cover_bytes(g, target_lvl);
+            mmu_hw_dc old = mmu_tbl_get_dc(tbl, i + k, g);
 
-        tbl.dcs[i] = bd_build(cfg, pa, g, target_lvl);
+            tbl.dcs[i + k] = bd_build(cfg, pa + k * c, g, target_lvl);
 
-        // if it was a table, free it (and all the subtables)
-        if (dc_get_valid(old) &&
-            dc_get_type(old, g, target_lvl) == MMU_DESCRIPTOR_TABLE)
-            free_tbl(m, tbl_from_td(m, old, target_lvl), target_lvl, info);
+            if (entries > 1)
+                dc_set_contiguous(&tbl.dcs[i + k], true);
+
+            // if it was a table, free it (and all the subtables)
+            if (dc_get_valid(old) &&
+                dc_get_type(old, g, target_lvl) == MMU_DESCRIPTOR_TABLE)
+                free_tbl(
+                    m,
+                    tbl_from_td(m, old, target_lvl),
+                    target_lvl + 1,
+                    info);
+        }
 
         size -= cover;
         pa += cover;
@@ -172,18 +319,40 @@ mmu_map_result mmu_map(
 #endif
 
     MMU_APPLY_CHANGES();
+    walk_cache_invalidate(m);
 
     return MMU_MAP_OK;
 }
 
 
+size_t mmu_map_max_tbls(const mmu_mapping* m, v_uintptr_t va, size_t size)
+{
+    size_t n = 0;
+
+    if (!m || size == 0)
+        return 0;
+
+    // one table for every span of the parent level touched by the range
+    for (mmu_tbl_level l = MMU_TBL_LV1; l <= max_level(m->g_); l++) {
+        const size_t span = dc_cover_bytes(m->g_, l - 1);
+        const v_uintptr_t first = va / span;
+        const v_uintptr_t last = (va + size - 1) / span;
+
+        n += last - first + 1;
+    }
+
+    return n;
+}
+
+
 mmu_unmap_result
-mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
+mmu_unmap(mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
 {
-    size_t cover;
+    size_t cover, entries;
     size_t i;
     mmu_granularity g = m->g_;
     mmu_tbl_level l, target_lvl;
+    mmu_tbl path[MMU_TBL_LV3 + 1];
 
     if (size == 0)
         return MMU_UNMAP_OK;
@@ -197,10 +366,12 @@ mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
     while (size > 0) {
         mmu_tbl tbl = TBL0;
 
-        if (size % g != 0 || va % g != 0)
+        if (size % g != 0 || va % g != 0) {
+            walk_cache_invalidate(m);
             return MMU_UNMAP_ERR;
+        }
 
-        get_target_lvl(&target_lvl, &cover, size, g, va, 0);
+        get_target_lvl(&target_lvl, &cover, &entries, size, g, va, 0);
 
 
         DEBUG_ASSERT(size % g == 0 || va % g == 0);
@@ -214,6 +385,7 @@ mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
             if (info)
                 info->iters += 1;
 
+            path[l] = tbl;
             i = table_index(va, g, l);
 
             mmu_hw_dc dc = mmu_tbl_get_dc(tbl, i, g);
@@ -226,7 +398,7 @@ mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
 
             switch (dc_get_type(dc, g, l)) {
                 case MMU_DESCRIPTOR_BLOCK:
-                    tbl = split_block(m, tbl, i, l, info);
+                    tbl = split_block(m, tbl, i, l, va, info);
                     continue;
                 case MMU_DESCRIPTOR_TABLE:
                     tbl = tbl_from_td(m, dc, l);
@@ -239,58 +411,192 @@ mmu_unmap(const mmu_mapping* m, v_uintptr_t va, size_t size, mmu_op_info* info)
         }
 
         if (already_unmapped) {
-            cover = min(size, dc_cover_bytes(g, l));
+            // skip up to the end of the unmapped descriptor
+            const size_t c = dc_cover_bytes(g, l);
+
+            cover = min(size, c - (va % c));
             size -= cover;
             va += cover;
             continue;
         }
 
-        // build the null block descriptor
+        path[target_lvl] = tbl;
+
+        // build the null block descriptors
         i = table_index(va, g, target_lvl);
-        mmu_hw_dc old = mmu_tbl_get_dc(tbl, i, g);
 
-        tbl.dcs[i] = NULL_PD;
+        // the rest of the run stays mapped, so it loses the contiguous hint
+        if (entries == 1 && dc_get_contiguous(mmu_tbl_get_dc(tbl, i, g)))
+            unfold_contig(tbl, i, g, target_lvl);
+
+        for (size_t k = 0; k < entries; k++) {
+            mmu_hw_dc old = mmu_tbl_get_dc(tbl, i + k, g);
 
-        // if it was a table, free it (and all the subtables)
-        if (dc_get_type(old, g, target_lvl) == MMU_DESCRIPTOR_TABLE &&
-            dc_get_valid(old))
-            free_tbl(m, tbl_from_td(m, old, target_lvl), target_lvl, info);
+            tbl.dcs[i + k] = NULL_PD;
+
+            // if it was a table, free it (and all the subtables)
+            if (dc_get_valid(old) &&
+                dc_get_type(old, g, target_lvl) == MMU_DESCRIPTOR_TABLE)
+                free_tbl(
+                    m,
+                    tbl_from_td(m, old, target_lvl),
+                    target_lvl + 1,
+                    info);
+        }
+
+        // once the op leaves the table (or ends), check if it can be reclaimed.
+        // Checking only at that point keeps big unmaps from rescanning the
+        // same table for every entry
+        if (target_lvl > MMU_TBL_LV0 &&
+            (size == cover ||
+             (va + cover) % dc_cover_bytes(g, target_lvl - 1) == 0))
+            reclaim_null_tbls(m, path, target_lvl, va, info);
 
         size -= cover;
         va += cover;
     }
 
-
-    // TODO: Collapse null tables
-    /*
-     *  tbl = tbl0;
-     *  // another final look to see if a table is fully null and collapse it
-     *  for (l = MMU_TBL_LV0; l <= max_level(g); l++) {
-     *      i = table_index(virt, g, l);
-     *
-     *      mmu_hw_dc dc = tbl.dcs[i];
-     *
-     *      if (!dc_get_valid(dc))
-     *          break;
-     *
-     *      if (dc_get_type(dc) == MMU_PD_TABLE) {
-     *          mmu_tbl subtbl = tbl_from_td(dc, g);
-     *
-     *          if (tbl_is_null(subtbl, g)) {
-     *              tbl.dcs[i] = NULL_PD;
-     *
-     *              UNLOCKED_free_subtree(h, tbl_from_td(dc, g), info);
-     *              break;
-     *          }
-     *
-     *          tbl = subtbl;
-     *      }
-     *  }
-     */
-
 #ifdef DEBUG
     DEBUG_ASSERT(size == 0 && va == expected_virt_end);
 #endif
 
+    MMU_APPLY_CHANGES();
+    walk_cache_invalidate(m);
+
     return MMU_UNMAP_OK;
 }
+
+
+void mmu_promote(
+    mmu_mapping* m,
+    v_uintptr_t va,
+    size_t size,
+    mmu_op_info* info)
+{
+    const mmu_granularity g = m->g_;
+    mmu_tbl path[MMU_TBL_LV3 + 1];
+    mmu_tbl_level l;
+
+    if (!m || size == 0 || !is_in_range(m, va, size))
+        return;
+
+    const v_uintptr_t first = va;
+    const v_uintptr_t last_byte = va + (size - 1);
+
+    while (size > 0) {
+        path[MMU_TBL_LV0] = mmu_mapping_get_tbl(m);
+
+        // find the deepest table that translates va
+        for (l = MMU_TBL_LV0; l < max_level(g); l++) {
+            if (info)
+                info->iters += 1;
+
+            mmu_hw_dc dc = mmu_tbl_get_dc(path[l], table_index(va, g, l), g);
+
+            if (!dc_get_valid(dc) ||
+                dc_get_type(dc, g, l) != MMU_DESCRIPTOR_TABLE)
+                break;
+
+            path[l + 1] = tbl_from_td(m, dc, l);
+        }
+
+        const size_t step = dc_cover_bytes(g, l) - (va % dc_cover_bytes(g, l));
+        const bool last = step >= size;
+
+        // a table is only checked once the scan reaches its last entry, and
+        // promoting it may complete its parent. Only the tables fully inside
+        // the range, the rest of them can be in use
+        for (; l > MMU_TBL_LV0; l--) {
+            const size_t parent_cover = dc_cover_bytes(g, l - 1);
+            const v_uintptr_t tbl_start = va & ~(v_uintptr_t)(parent_cover - 1);
+
+            if ((va + step) % parent_cover != 0 || tbl_start < first ||
+                tbl_start + (parent_cover - 1) > last_byte)
+                break;
+
+            if (!tbl_is_promotable(path[l], g, l))
+                break;
+
+            const mmu_tbl parent = path[l - 1];
+            const size_t i = table_index(va, g, l - 1);
+            const mmu_hw_dc first_dc = path[l].dcs[0];
+
+            // break-before-make, the translation size changes
+            parent.dcs[i] = NULL_PD;
+            MMU_APPLY_CHANGES();
+            parent.dcs[i] = bd_build(
+                cfg_from_dc(first_dc),
+                dc_get_output_address(first_dc, g),
+                g,
+                l - 1);
+
+            free_tbl(m, path[l], l, info);
+        }
+
+        if (last)
+            break;
+
+        size -= step;
+        va += step;
+    }
+
+    MMU_APPLY_CHANGES();
+    walk_cache_invalidate(m);
+}
+
+
+mmu_translation mmu_translate(mmu_mapping* m, v_uintptr_t va)
+{
+    mmu_translation t = {.mapped = false};
+
+    if (!m || !is_in_range(m, va, 1))
+        return t;
+
+    const mmu_granularity g = m->g_;
+    const uint64_t gen = __atomic_load_n(&m->walk_cache_.gen, __ATOMIC_ACQUIRE);
+
+    mmu_tbl_level l;
+    mmu_tbl tbl = walk_cache_lookup(m, gen, va, &l);
+    const mmu_tbl_level cached = l;
+
+    for (;; l++) {
+        const mmu_hw_dc dc = mmu_tbl_get_dc(tbl, table_index(va, g, l), g);
+
+        if (dc_get_valid(dc) && l < max_level(g) &&
+            dc_get_type(dc, g, l) == MMU_DESCRIPTOR_TABLE) {
+            tbl = tbl_from_td(m, dc, l);
+            continue;
+        }
+
+        if (dc_get_valid(dc)) {
+            const size_t cover = dc_cover_bytes(g, l);
+
+            t.mapped = true;
+            t.pa = dc_get_output_address(dc, g) + (va % cover);
+            t.leaf_bytes = cover;
+            t.cfg = cfg_from_dc(dc);
+        }
+
+        break;
+    }
+
+    if (l > cached)
+        walk_cache_fill(m, gen, va, tbl, l);
+
+    return t;
+}
+
+
+bool mmu_translate_current(v_uintptr_t va, p_uintptr_t* pa)
+{
+    const uint64_t par = _mmu_at_S1E1R(va);
+
+    // PAR_EL1.F
+    if (par & 1ULL)
+        return false;
+
+    if (pa)
+        *pa = (par & MMU_DC_OUTPUT_ADDR_MASK) | (va & (4 * MEM_KiB - 1));
+
+    return true;
+}
@@ -203,6 +203,22 @@ bool mmu_core_set_hi_va_bits(mmu_core_handle* ch, uint8_t bits)
     return true;
 }
 
+bool mmu_core_set_mair_attr(mmu_core_handle* ch, uint8_t index, uint8_t attr)
+{
+    ASSERT(ch);
+    uint64_t sctlr = _mmu_get_SCTLR_EL1();
+    if (mmu_on(sctlr))
+        return false;
+
+    if (index >= 8)
+        return false;
+
+    ch->mair &= ~MMU_MAIR_ATTR(index, 0xFF);
+    ch->mair |= MMU_MAIR_ATTR(index, attr);
+
+    return true;
+}
+
 bool mmu_core_set_lo_granularity(mmu_core_handle* ch, mmu_granularity g)
 {
     ASSERT(ch);
@@ -312,6 +328,8 @@ bool mmu_core_handle_new(
 
     MMU_CORE_ASSERT_SET(set_coreid(out));
 
+    out->mair = MMU_MAIR_DEFAULT;
+
 #undef MMU_CORE_ASSERT_SET
 
     return true;
@@ -360,13 +378,6 @@ mmu_activate_result mmu_core_activate(mmu_core_handle* ch)
         return MMU_ACTIVATE_INVALID_HI_BITS;
 
 
-    /*
-     * TODO: configurable mair
-     * AttrIdx 0: Normal memory, WB WA
-     * AttrIdx 1: Device-nGnRE
-     * https://df.lth.se/~getz/ARM/SysReg/AArch64-mair_el1.html
-     */
-    uint64_t mair = (0xFFUL << 0) | (0x04UL << 8);
     uint64_t tcr = 0;
 
 
@@ -449,7 +460,7 @@ mmu_activate_result mmu_core_activate(mmu_core_handle* ch)
     sctlr |= (1ULL << 0);                             /* M MMU enable */
 
 
-    _mmu_set_MAIR_EL1(mair);
+    _mmu_set_MAIR_EL1(mmu_core_get_mair(ch));
     _mmu_set_TCR_EL1(tcr);
 
     MMU_APPLY_CHANGES();
@@ -86,6 +86,9 @@ static inline uint64_t output_address_mask_(mmu_granularity g)
 #define MMU_DC_AF_SHIFT 10
 #define MMU_DC_AF_WIDTH 1
 
+#define MMU_DC_CONT_SHIFT 52
+#define MMU_DC_CONT_WIDTH 1
+
 #define MMU_DC_PXN_SHIFT 53
 #define MMU_DC_PXN_WIDTH 1
 
@@ -164,6 +167,12 @@ dc_get_output_address(const mmu_hw_dc dc, mmu_granularity g)
     return dc.v & output_address_mask_(g);
 }
 
+static inline bool dc_get_contiguous(const mmu_hw_dc dc)
+{
+    return (bool)((dc.v >> MMU_DC_CONT_SHIFT) &
+                  MMU_DC_BITS(MMU_DC_CONT_WIDTH));
+}
+
 static inline bool dc_get_privileged_execute_never(const mmu_hw_dc dc)
 {
     return (bool)((dc.v >> MMU_DC_PXN_SHIFT) & MMU_DC_BITS(MMU_DC_PXN_WIDTH));
@@ -238,6 +247,12 @@ dc_set_output_address(mmu_hw_dc* dc, p_uintptr_t output_address)
 }
 
 
+static inline void dc_set_contiguous(mmu_hw_dc* dc, bool contiguous)
+{
+    dc->v &= ~MMU_DC_FIELD_MASK(MMU_DC_CONT_SHIFT, MMU_DC_CONT_WIDTH);
+    dc->v |= ((uint64_t)contiguous << MMU_DC_CONT_SHIFT);
+}
+
 static inline void dc_set_privileged_execute_never(mmu_hw_dc* dc, bool pxn)
 {
     dc->v &= ~MMU_DC_FIELD_MASK(MMU_DC_PXN_SHIFT, MMU_DC_PXN_WIDTH);
@@ -45,6 +45,64 @@ static inline size_t tbl_entries(mmu_granularity g)
 }
 
 
+/// returns true if a block descriptor can be placed at level l. Only the 4KB
+/// granule supports level 1 blocks (without FEAT_LPA/LPA2)
+static inline bool lvl_has_blocks(mmu_granularity g, mmu_tbl_level l)
+{
+    if (l >= max_level(g))
+        return false;
+
+    if (g == MMU_GRANULARITY_4KB)
+        return l >= MMU_TBL_LV1;
+
+    return l == max_level(g) - 1;
+}
+
+
+/// number of adjacent entries of level l that form a contiguous-hint run. 1 if
+/// the level can not hold leaf descriptors
+static inline size_t contig_entries(mmu_granularity g, mmu_tbl_level l)
+{
+    if (l < max_level(g) && !lvl_has_blocks(g, l))
+        return 1;
+
+    switch (g) {
+        case MMU_GRANULARITY_4KB:
+            return 16;
+        case MMU_GRANULARITY_16KB:
+            return l == max_level(g) ? 128 : 32;
+        case MMU_GRANULARITY_64KB:
+            return 32;
+    }
+
+    return 1;
+}
+
+
+/// clears the contiguous hint of the run holding the entry i of tbl (a table of
+/// level l). Changing the hint of live entries requires break-before-make, so
+/// the run is briefly unmapped
+static inline void
+unfold_contig(mmu_tbl tbl, size_t i, mmu_granularity g, mmu_tbl_level l)
+{
+    const size_t n = contig_entries(g, l);
+    mmu_hw_dc* run = &tbl.dcs[i - (i % n)];
+
+    for (size_t k = 0; k < n; k++)
+        if (dc_get_contiguous(run[k]))
+            dc_set_valid(&run[k], false);
+
+    MMU_APPLY_CHANGES();
+
+    for (size_t k = 0; k < n; k++) {
+        if (dc_get_contiguous(run[k])) {
+            dc_set_contiguous(&run[k], false);
+            dc_set_valid(&run[k], true);
+        }
+    }
+}
+
+
 static inline mmu_tbl
 tbl_from_td(const mmu_mapping* m, mmu_hw_dc dc, mmu_tbl_level l)
 {
@@ -102,25 +160,37 @@ alloc_tbl(const mmu_mapping* m, bool init_null, mmu_op_info* info)
 
     ASSERT((v_uintptr_t)tbl.dcs % m->g_ == 0);
 
+    // the allocators return zeroed tables, so zeroing stays out of the walk
+#ifdef DEBUG
     if (init_null)
-        tbl_init_null(tbl, m->g_);
+        for (size_t i = 0; i < tbl_entries(m->g_); i++)
+            DEBUG_ASSERT(tbl.dcs[i].v == 0, "alloc_tbl: table not zeroed");
+#else
+    (void)init_null;
+#endif
 
     return tbl;
 }
 
 
 /// divides a block into a next level table and udcates the parent. Returns the
-/// created table (of a lower level)
+/// created table (of a lower level). The new entries are grouped in contiguous
+/// runs, except the run that translates va, as the caller is about to modify it
 static inline mmu_tbl split_block(
     const mmu_mapping* m,
     mmu_tbl parent,
     size_t index,
     mmu_tbl_level l,
+    v_uintptr_t va,
     mmu_op_info* info)
 {
+    const mmu_granularity g = m->g_;
+
+    if (dc_get_contiguous(parent.dcs[index]))
+        unfold_contig(parent, index, g, l);
+
     const mmu_hw_dc old = parent.dcs[index];
     const mmu_tbl new_tbl = alloc_tbl(m, false, info);
-    const mmu_granularity g = m->g_;
 
     DEBUG_ASSERT(l < max_level(g));
     DEBUG_ASSERT(dc_get_type(old, g, l) == MMU_DESCRIPTOR_BLOCK);
@@ -130,10 +200,16 @@ static inline mmu_tbl split_block(
         mmu_pg_cfg cfg = cfg_from_dc(old);
         p_uintptr_t pa = dc_get_output_address(old, g);
         size_t new_l_bytes = dc_cover_bytes(g, l + 1);
+        const size_t run = contig_entries(g, l + 1);
+        const size_t skip = table_index(va, g, l + 1) / run;
         ASSERT(pa % dc_cover_bytes(g, l) == 0);
 
-        for (size_t i = 0; i < tbl_entries(g); i++)
+        for (size_t i = 0; i < tbl_entries(g); i++) {
             new_tbl.dcs[i] = bd_build(cfg, pa + (i * new_l_bytes), g, l + 1);
+
+            if (run > 1 && i / run != skip)
+                dc_set_contiguous(&new_tbl.dcs[i], true);
+        }
     }
     else {
         tbl_init_null(new_tbl, g);
@@ -147,6 +223,46 @@ static inline mmu_tbl split_block(
 }
 
 
+/// returns true if every entry of tbl (a table of level l) is a valid leaf
+/// with the same attributes, and together they map a physically contiguous
+/// range aligned to the parent cover. Such a table can be replaced by a single
+/// block descriptor of level l - 1
+static inline bool
+tbl_is_promotable(mmu_tbl tbl, mmu_granularity g, mmu_tbl_level l)
+{
+    if (l == MMU_TBL_LV0 || !lvl_has_blocks(g, l - 1))
+        return false;
+
+    const mmu_hw_dc first = tbl.dcs[0];
+
+    if (!dc_get_valid(first) ||
+        dc_get_type(first, g, l) == MMU_DESCRIPTOR_TABLE)
+        return false;
+
+    // the contiguous hint may differ between runs
+    const uint64_t ignored =
+        output_address_mask_(g) |
+        MMU_DC_FIELD_MASK(MMU_DC_CONT_SHIFT, MMU_DC_CONT_WIDTH);
+
+    const p_uintptr_t pa = dc_get_output_address(first, g);
+    const uint64_t attrs = first.v & ~ignored;
+    const size_t cover = dc_cover_bytes(g, l);
+
+    if (pa % dc_cover_bytes(g, l - 1) != 0)
+        return false;
+
+    for (size_t i = 1; i < tbl_entries(g); i++) {
+        const mmu_hw_dc dc = tbl.dcs[i];
+
+        if ((dc.v & ~ignored) != attrs ||
+            dc_get_output_address(dc, g) != pa + i * cover)
+            return false;
+    }
+
+    return true;
+}
+
+
 static inline bool tbl_is_null(mmu_tbl tbl, mmu_granularity g)
 {
     for (size_t i = 0; i < tbl_entries(g); i++)
@@ -157,13 +273,15 @@ static inline bool tbl_is_null(mmu_tbl tbl, mmu_granularity g)
 }
 
 
+/// frees tbl (a table of level l) and all its subtables
 static inline void
 free_tbl(const mmu_mapping* m, mmu_tbl tbl, mmu_tbl_level l, mmu_op_info* info)
 {
-    for (size_t i = 0; i < tbl_entries(m->g_); i++)
-        if (dc_get_valid(tbl.dcs[i]) &&
-            dc_get_type(tbl.dcs[i], m->g_, l) == MMU_DESCRIPTOR_TABLE)
-            free_tbl(m, tbl_from_td(m, tbl.dcs[i], l + 1), l + 1, info);
+    if (l < max_level(m->g_))
+        for (size_t i = 0; i < tbl_entries(m->g_); i++)
+            if (dc_get_valid(tbl.dcs[i]) &&
+                dc_get_type(tbl.dcs[i], m->g_, l) == MMU_DESCRIPTOR_TABLE)
+                free_tbl(m, tbl_from_td(m, tbl.dcs[i], l), l + 1, info);
 
 
     m->allocator_free_(tbl.dcs);
@@ -20,3 +20,6 @@ extern uint64_t _mmu_get_TCR_EL1(void);
 extern void _mmu_set_TCR_EL1(uint64_t v);
 
 extern uint64_t _mmu_get_ID_AA64MMFR0_EL1(void);
+
+/// runs AT S1E1R with the irqs masked and returns PAR_EL1
+extern uint64_t _mmu_at_S1E1R(uint64_t va);
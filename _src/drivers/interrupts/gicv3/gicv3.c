@@ -16,6 +16,7 @@ extern void _GICV3_ARM_ICC_PMR_EL1_write(uint64_t v);
 extern void _GICV3_ARM_ICC_IGRPEN1_EL1_write(uint64_t v);
 extern void _GICV3_ARM_ICC_EOIR1_EL1_write(uint64_t v);
 extern uint64_t _GICV3_ARM_ICC_IAR1_EL1_read(void);
+extern void _GICV3_ARM_ICC_SGI1R_EL1_write(uint64_t v);
 
 void GICV3_set_cpu_priority_threshold(uint8_t threshold)
 {
@@ -203,6 +204,20 @@ void GICV3_ack_intid_el1(irq_id id)
     _GICV3_ARM_ICC_EOIR1_EL1_write(id.n);
 }
 
+void GICV3_send_sgi(irq_id id, ARM_cpu_affinity cpu)
+{
+    ASSERT(GICV3_irq_id_is_sgi(id));
+    ASSERT(cpu.aff0 < 16, "GICV3_send_sgi: aff0 out of the target list");
+
+    // ICC_SGI1R_EL1: TargetList[15:0], Aff1[23:16], INTID[27:24],
+    // Aff2[39:32], IRM[40] = 0, Aff3[55:48]
+    uint64_t v = (1ULL << cpu.aff0) | ((uint64_t)cpu.aff1 << 16) |
+                 ((id.n & 0xFULL) << 24) | ((uint64_t)cpu.aff2 << 32) |
+                 ((uint64_t)cpu.aff3 << 48);
+
+    _GICV3_ARM_ICC_SGI1R_EL1_write(v);
+}
+
 void GICV3_enable_ppi(const driver_handle* h, irq_id id, ARM_cpu_affinity cpu)
 {
     size_t rd = cpu.aff0;
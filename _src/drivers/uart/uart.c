@@ -3,6 +3,8 @@
 #include <kernel/mm.h>
 #include <kernel/panic.h>
 #include <lib/lock/irqlock.h>
+#include <lib/lock/spinlock.h>
+#include <lib/lock/spinlock_irq.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -110,6 +112,11 @@ void uart_reset(const driver_handle* h)
 
     for (size_t i = 0; i < UART_RX_BUF_SIZE; i++)
         state->rx.buf[i] = 0;
+
+    state->sg.lock = (spinlock_t)SPINLOCK_INIT;
+    state->sg.head = 0;
+    state->sg.tail = 0;
+    state->sg.off = 0;
 }
 
 bool uart_read(const driver_handle* h, uint8_t* data)
@@ -369,9 +376,46 @@ static void handle_RRDY_(const driver_handle* h)
     } while (!UART_UTS_RXEMPTY_get(UART_UTS_read(h->base)));
 }
 
+/// fills the tx fifo from the scatter gather segments. Returns false if there
+/// are none left
+static bool tx_sg_drain_(const driver_handle* h)
+{
+    uart_state* state = uart_get_state_(h);
+    uart_sg done[UART_TX_SG_LEN];
+    size_t n_done = 0;
+    bool pending;
+
+    spinlocked(&state->sg.lock)
+    {
+        while (state->sg.head != state->sg.tail &&
+               !UART_UTS_TXFULL_get(UART_UTS_read(h->base))) {
+            const size_t i = state->sg.head & (UART_TX_SG_LEN - 1);
+            uart_sg* seg = &state->sg.seg[i];
+
+            UART_UTXD_write(h->base, seg->buf[state->sg.off++]);
+
+            if (state->sg.off == seg->len) {
+                if (seg->done)
+                    done[n_done++] = *seg;
+
+                state->sg.head++;
+                state->sg.off = 0;
+            }
+        }
+
+        pending = state->sg.head != state->sg.tail;
+    }
+
+    // out of the lock, they can queue more segments
+    for (size_t i = 0; i < n_done; i++)
+        done[i].done(done[i].arg);
+
+    return pending;
+}
+
 // UART_IRQ_SRC_TRDY: Tx hardware fifo reached less or the stablished value , it
 // tries to fill the buffer again with the data saved in the software driver tx
-// buffer
+// buffer, and then with the scatter gather segments
 static void handle_TRDY_(const driver_handle* h)
 {
 #ifdef TEST
@@ -387,8 +431,9 @@ static void handle_TRDY_(const driver_handle* h)
         if (txbuf_empty) {
             // disable the tx threashold irq, as there is
             // no more data available to send. It is enabled again when using
-            // uart_putc
-            uart_set_irq_state_(h, UART_IRQ_SRC_TRDY, false);
+            // uart_putc or uart_write_sg
+            if (!tx_sg_drain_(h))
+                uart_set_irq_state_(h, UART_IRQ_SRC_TRDY, false);
 
             break;
         }
@@ -531,6 +576,29 @@ term_out_result uart_putc(const driver_handle* h, const char c)
 }
 
 
+bool uart_write_sg(const driver_handle* h, const uart_sg* segs, size_t n)
+{
+    uart_state* state = uart_get_state_(h);
+    bool queued = false;
+
+    irq_spinlocked(&state->sg.lock)
+    {
+        if (state->sg.tail - state->sg.head + n <= UART_TX_SG_LEN) {
+            for (size_t i = 0; i < n; i++)
+                state->sg.seg[state->sg.tail++ & (UART_TX_SG_LEN - 1)] =
+                    segs[i];
+
+            queued = true;
+        }
+    }
+
+    if (queued && !uart_get_irq_state_(h, UART_IRQ_SRC_TRDY))
+        uart_set_irq_state_(h, UART_IRQ_SRC_TRDY, true);
+
+    return queued;
+}
+
+
 /*
  *  Uart early
  */
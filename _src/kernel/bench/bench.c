@@ -0,0 +1,353 @@
+#include <arm/cache.h>
+#include <arm/sysregs/arm_generic_timer.h>
+#include <drivers/arm_generic_timer/arm_generic_timer.h>
+#include <drivers/interrupts/gicv3/gicv3.h>
+#include <kernel/bench.h>
+#include <kernel/devices/drivers.h>
+#include <kernel/init.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/sched_trace.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arm/cpu.h"
+#include "kernel/io/stdio.h"
+#include "kernel/mm.h"
+#include "kernel/panic.h"
+#include "lib/math.h"
+
+_Static_assert(BENCH_SYSC_NR == SYSC_BENCH, "bench: syscall number mismatch");
+_Static_assert(
+    BENCH_SLEEP_SYSC_NR == SYSC_SLEEP,
+    "bench: syscall number mismatch");
+
+
+// user va of the bench task
+#define USR_CODE 0x400000
+#define USR_DATA 0x800000
+#define USR_STACK 0xC00000
+
+// the threads are pinned to BENCH_CORE, the sleep test also runs one on
+// BENCH_CORE2
+#define BENCH_CORE 0
+#define BENCH_CORE2 (1 % NUM_CORES)
+#define BENCH_THREADS 2
+
+#define RUN_SAMPLES (BENCH_WARMUP + BENCH_SAMPLES + BENCH_WARMUP)
+#define BUF_PAGES DIV_CEIL(RUN_SAMPLES * sizeof(uint64_t), KPAGE_SIZE)
+#define DATA_PAGES (1 + BENCH_THREADS * BUF_PAGES)
+
+#define PMCR_E (1UL << 0)
+#define PMCR_LC (1UL << 6)
+#define PMCNTEN_C (1UL << 31)
+#define PMUSERENR_EN (1UL << 0)
+#define PMUSERENR_CR (1UL << 2)
+
+
+extern char _bench_user_start[];
+extern char _bench_user_end[];
+extern char _bench_user_ping[];
+extern char _bench_user_irq[];
+extern char _bench_user_vmalloc[];
+extern char _bench_user_sleep[];
+
+
+typedef enum {
+    BENCH_SYSCALL,
+    BENCH_SWITCH,
+    BENCH_IRQ,
+    BENCH_VMALLOC,
+    BENCH_SLEEP,
+
+    BENCH_TESTS,
+} bench_test;
+
+static const char* const TEST_NAME[BENCH_TESTS] = {
+    "syscall",
+    "switch",
+    "irq",
+    "vmalloc",
+    "sleep",
+};
+
+static const char* const TEST_UNIT[BENCH_TESTS] = {
+    BENCH_UNIT,
+    BENCH_UNIT,
+    BENCH_UNIT,
+    BENCH_UNIT,
+    "ticks",
+};
+
+
+// first page of the data region, the sample buffers follow it
+typedef struct {
+    uint64_t stamp;                  // counter before the svc of a ping
+    uint64_t args[BENCH_THREADS][3]; // x0 of each thread points to its args
+} bench_ctl;
+
+
+static struct {
+    utask* task;
+    uint8_t* data; // kernel va of the data region
+    bench_test test;
+    uint32_t running; // threads of the test that did not end yet
+} bench;
+
+
+static inline uint64_t usr_data(size_t offset)
+{
+    return USR_DATA + offset;
+}
+
+
+static inline uint64_t usr_buf(size_t i)
+{
+    return usr_data((1 + i * BUF_PAGES) * KPAGE_SIZE);
+}
+
+
+static inline uint64_t* knl_buf(size_t i)
+{
+    return (uint64_t*)(bench.data + (1 + i * BUF_PAGES) * KPAGE_SIZE);
+}
+
+
+static void spawn(
+    const char* fn,
+    size_t slot,
+    size_t core,
+    uint64_t a0,
+    uint64_t a1)
+{
+    bench_ctl* ctl = (bench_ctl*)bench.data;
+
+    ctl->args[slot][0] = a0;
+    ctl->args[slot][1] = a1;
+    ctl->args[slot][2] = usr_data(offsetof(bench_ctl, stamp));
+
+    thread* th = scheduler_thread_new(
+        bench.task,
+        USR_CODE + (uint64_t)(fn - _bench_user_start),
+        USR_STACK + (slot + 1) * KPAGE_SIZE,
+        usr_data(offsetof(bench_ctl, args[slot])));
+
+    // first samples of a thread queued elsewhere are dropped as warmup
+    scheduler_set_affinity(th, 1U << core);
+}
+
+
+static void start_test(bench_test test)
+{
+    bench.test = test;
+
+    switch (test) {
+        case BENCH_SYSCALL:
+            bench.running = 1;
+            spawn(_bench_user_ping, 0, BENCH_CORE, usr_buf(0), RUN_SAMPLES);
+            break;
+
+        case BENCH_SWITCH:
+            bench.running = 2;
+            spawn(_bench_user_ping, 0, BENCH_CORE, usr_buf(0), RUN_SAMPLES);
+            spawn(_bench_user_ping, 1, BENCH_CORE, usr_buf(1), RUN_SAMPLES);
+            break;
+
+        case BENCH_IRQ:
+            bench.running = 1;
+            spawn(_bench_user_irq, 0, BENCH_CORE, usr_buf(0), RUN_SAMPLES);
+            break;
+
+        case BENCH_VMALLOC:
+            bench.running = 1;
+            spawn(_bench_user_vmalloc, 0, BENCH_CORE, usr_buf(0), RUN_SAMPLES);
+            break;
+
+        case BENCH_SLEEP:
+            bench.running = 2;
+            spawn(_bench_user_sleep, 0, BENCH_CORE, usr_buf(0), RUN_SAMPLES);
+            spawn(_bench_user_sleep, 1, BENCH_CORE2, usr_buf(1), RUN_SAMPLES);
+            break;
+
+        default:
+            PANIC("bench: invalid test");
+    }
+}
+
+
+/// moves s[i] down the max heap s[0..n)
+static void sift_down(uint64_t* s, size_t i, size_t n)
+{
+    uint64_t v = s[i];
+
+    for (size_t c; (c = 2 * i + 1) < n; i = c) {
+        if (c + 1 < n && s[c + 1] > s[c])
+            c++;
+
+        if (s[c] <= v)
+            break;
+
+        s[i] = s[c];
+    }
+
+    s[i] = v;
+}
+
+
+// heap sort, the report runs in the syscall with the irqs masked
+static void sort(uint64_t* s, size_t n)
+{
+    for (size_t i = n / 2; i > 0; i--)
+        sift_down(s, i - 1, n);
+
+    for (size_t end = n; end > 1; end--) {
+        uint64_t top = s[0];
+        s[0] = s[end - 1];
+        s[end - 1] = top;
+
+        sift_down(s, 0, end - 1);
+    }
+}
+
+
+static inline uint32_t sat_u32(uint64_t v)
+{
+    return v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+}
+
+
+static void report(bench_test test)
+{
+    size_t bufs = test == BENCH_SWITCH || test == BENCH_SLEEP ? 2 : 1;
+    size_t n = bufs * BENCH_SAMPLES;
+
+    uint64_t* s = kmalloc(n * sizeof(uint64_t));
+    ASSERT(s, "bench: could not allocate the samples");
+
+    // the warmup at the start covers the migration to BENCH_CORE, the one at
+    // the end the last pings, once the other thread ended
+    for (size_t b = 0; b < bufs; b++)
+        for (size_t i = 0; i < BENCH_SAMPLES; i++)
+            s[b * BENCH_SAMPLES + i] = knl_buf(b)[BENCH_WARMUP + i];
+
+    sort(s, n);
+
+    kprintf(
+        "bench: %s %s min %u median %u p99 %u (%u samples)\n\r",
+        TEST_NAME[test],
+        TEST_UNIT[test],
+        sat_u32(s[0]),
+        sat_u32(s[n / 2]),
+        sat_u32(s[n * 99 / 100]),
+        (uint32_t)n);
+
+    kfree(s);
+}
+
+
+void bench_start(void)
+{
+    size_t code_bytes = (size_t)(_bench_user_end - _bench_user_start);
+    size_t code_pages = DIV_CEIL(code_bytes, KPAGE_SIZE);
+
+    bench.task = utask_new("bench");
+
+    uint8_t* code =
+        umalloc(bench.task, USR_CODE, code_pages, true, false, true, true);
+    bench.data =
+        umalloc(bench.task, USR_DATA, DATA_PAGES, true, true, false, true);
+    umalloc(bench.task, USR_STACK, BENCH_THREADS, true, true, false, true);
+
+    for (size_t i = 0; i < code_bytes; i++)
+        code[i] = (uint8_t)_bench_user_start[i];
+
+    // written through the kernel va, executed from the user one
+    _cache_flush_range(
+        (uintptr_t)code,
+        (uintptr_t)code + code_pages * KPAGE_SIZE);
+
+    kprint("bench: start\n\r");
+    start_test(BENCH_SYSCALL);
+}
+
+#ifdef BENCH
+KERNEL_INITCALL(bench_start, KERNEL_INITCALL_STAGE2);
+#endif
+
+
+void bench_cpu_init(void)
+{
+    uint64_t pmcr;
+
+    asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+    asm volatile("msr pmcr_el0, %0" : : "r"(pmcr | PMCR_E | PMCR_LC));
+    asm volatile("msr pmcntenset_el0, %0" : : "r"(PMCNTEN_C));
+    asm volatile("msr pmuserenr_el0, %0"
+                 :
+                 : "r"(PMUSERENR_EN | PMUSERENR_CR));
+
+    asm volatile("isb");
+
+    GICV3_enable_ppi(
+        &GIC_DRIVER,
+        irq_id_new(BENCH_TIMER_PPI),
+        ARM_get_cpu_affinity());
+}
+
+
+// the dynamic path maps the page through vmalloc, which zeroes and copies its
+// metadata with the memset and memcpy calls emitted by gcc
+static void vmalloc_page(void)
+{
+    void* p = raw_kmalloc(1, "bench", &RAW_KMALLOC_DYNAMIC_CFG);
+    ASSERT(p, "bench: could not allocate the page");
+
+    raw_kfree(p);
+}
+
+
+int64_t sysc_bench(const uint64_t args[6])
+{
+    switch (args[0]) {
+        case BENCH_OP_NULL:
+            return 0;
+
+        case BENCH_OP_TIMER:
+            // disarmed by the irq handler (exception/el1/irq.c)
+            _ARM_CNTP_TVAL_EL0_set(AGT_us_to_cycles(BENCH_TIMER_DELAY_US));
+            _ARM_CNTP_CTL_EL0_set(1);
+            return 0;
+
+        case BENCH_OP_VMALLOC:
+            vmalloc_page();
+            return 0;
+
+        case BENCH_OP_FAIL:
+            kprintf("bench: %s failed\n\r", TEST_NAME[bench.test]);
+            PANIC("bench: a check of the user thread failed");
+
+        case BENCH_OP_DONE:
+            scheduler_sleep_current();
+            scheduler_current_thread()->ctx.x[0] = 0;
+
+            if (__atomic_sub_fetch(&bench.running, 1, __ATOMIC_ACQ_REL) == 0) {
+                report(bench.test);
+
+                if (bench.test + 1 < BENCH_TESTS)
+                    start_test(bench.test + 1);
+                else {
+                    kprint("bench: done\n\r");
+                    scheduler_print_task(bench.task);
+                    scheduler_print_stats();
+                    sched_trace_dump(IO_STDOUT);
+                }
+            }
+
+            return SYSC_RESULT_STORED;
+
+        default:
+            return SYSC_ERR_NOSYS;
+    }
+}
+
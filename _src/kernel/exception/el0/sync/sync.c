@@ -1,6 +1,8 @@
 #include <arm/exceptions/sync.h>
 #include <arm/sysregs/sysregs.h>
 #include <kernel/exception/handler.h>
+#include <kernel/fpu.h>
+#include <kernel/mm/umalloc.h>
 #include <kernel/syscall.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -45,7 +47,8 @@ void exception_handler_sync(arm_exception_ctx* ectx)
             break;
 
         case ESR_EC_FP_ASIMD_SVE:
-            dbg_print("exception: ESR_EC_FP_ASIMD_SVE\n\r");
+            // lazy fp switch, returns to the trapped instruction
+            fpu_handle_trap(scheduler_current_thread());
             break;
 
         case ESR_EC_PAUTH:
@@ -77,7 +80,10 @@ void exception_handler_sync(arm_exception_ctx* ectx)
             break;
 
         case ESR_EC_SVC_AARCH64:
-            dbg_print("exception: ESR_EC_SVC_AARCH64\n\r");
+            // register only syscalls return here, without saving the thread
+            if (sysc64_fast(ectx))
+                break;
+
             scheduler_ectx_save(ectx);
             sysc64_dispatch(ectx);
             schedurer_ectx_restore(ectx);
@@ -105,6 +111,16 @@ void exception_handler_sync(arm_exception_ctx* ectx)
 
         case ESR_EC_IABT_LOWER_EL:
             dbg_print("exception: ESR_EC_IABT_LOWER_EL\n\r");
+            // the ifsc is in the same bits as the dfsc
+            if (ESR_DFSC_IS_TRANSLATION(ESR_DABT_DFSC(esr_el1)) &&
+                umalloc_handle_translation_fault(
+                    scheduler_current_utask(),
+                    _ARM_FAR_EL1(),
+                    false,
+                    true))
+                break;
+
+            PANIC("ESR_EC_IABT_LOWER_EL: unhandled user instruction abort");
             break;
 
         case ESR_EC_IABT_SAME_EL:
@@ -117,6 +133,23 @@ void exception_handler_sync(arm_exception_ctx* ectx)
 
         case ESR_EC_DABT_LOWER_EL:
             dbg_print("exception: ESR_EC_DABT_LOWER_EL\n\r");
+            if (ESR_DFSC_IS_PERMISSION(ESR_DABT_DFSC(esr_el1)) &&
+                ESR_DABT_WNR(esr_el1) &&
+                umalloc_handle_write_fault(
+                    scheduler_current_utask(),
+                    _ARM_FAR_EL1()))
+                break;
+
+            // first touch of a lazy page
+            if (ESR_DFSC_IS_TRANSLATION(ESR_DABT_DFSC(esr_el1)) &&
+                umalloc_handle_translation_fault(
+                    scheduler_current_utask(),
+                    _ARM_FAR_EL1(),
+                    ESR_DABT_WNR(esr_el1),
+                    false))
+                break;
+
+            PANIC("ESR_EC_DABT_LOWER_EL: unhandled user data abort");
             break;
 
         case ESR_EC_DABT_SAME_EL:
@@ -1,4 +1,6 @@
+#include <arm/sysregs/arm_generic_timer.h>
 #include <drivers/uart/uart.h>
+#include <kernel/bench.h>
 #include <kernel/devices/drivers.h>
 #include <kernel/exception/interrupts.h>
 #include <kernel/init.h>
@@ -12,6 +14,7 @@
 #include "drivers/tmu/tmu.h"
 #include "kernel/devices/device.h"
 #include "kernel/io/stdio.h"
+#include "kernel/scheduler.h"
 
 typedef void (*driver_irq_handler)(const driver_handle* h);
 
@@ -37,6 +40,25 @@ build_handler_(driver_irq_handler handler, const driver_handle* h)
 }
 
 
+// the idle core just needs to leave wfi, it looks for threads again after it
+static void sched_wake_sgi_(const driver_handle*) {}
+
+
+static void sched_tick_ppi_(const driver_handle*)
+{
+    scheduler_timer_irq();
+}
+
+
+#ifdef BENCH
+// one shot timer of the irq latency test, armed by sysc_bench
+static void bench_timer_(const driver_handle*)
+{
+    _ARM_CNTP_CTL_EL0_set(0);
+}
+#endif
+
+
 static void handle_uart_test(const driver_handle* h)
 {
     uart_handle_irq(h);
@@ -62,9 +84,16 @@ static void init_irq_handler_table_()
     KERNEL_IRQ_HANDLER_TABLE_[IMX8MP_IRQ_ANAMIX_TEMP] =
         build_handler_(TMU_handle_irq, &TMU_DRIVER);
 
-    // TODO: 0..31 irq enum
-    KERNEL_IRQ_HANDLER_TABLE_[27] =
-        build_handler_(AGT_handle_irq, &AGT0_DRIVER);
+    // the virtual timer of every core belongs to the scheduler tick
+    KERNEL_IRQ_HANDLER_TABLE_[SCHED_TICK_PPI] =
+        build_handler_(sched_tick_ppi_, NULL);
+    KERNEL_IRQ_HANDLER_TABLE_[SCHED_WAKE_SGI] =
+        build_handler_(sched_wake_sgi_, NULL);
+
+#ifdef BENCH
+    KERNEL_IRQ_HANDLER_TABLE_[BENCH_TIMER_PPI] =
+        build_handler_(bench_timer_, NULL);
+#endif
 }
 
 KERNEL_INITCALL(init_irq_handler_table_, KERNEL_INITCALL_STAGE0);
@@ -79,3 +108,12 @@ void exception_handler_irq()
 
     GICV3_ack_intid_el1(irq);
 }
+
+
+void exception_handler_irq_lower(arm_exception_ctx* ectx)
+{
+    // the thread is saved before the handler, as a tick can switch it
+    scheduler_irq_enter(ectx);
+    exception_handler_irq();
+    scheduler_irq_exit(ectx);
+}
@@ -59,3 +59,9 @@ void fkprint(io_out io, const char* s)
 {
     term_prints(STDIO_OUTPUTS[io], s);
 }
+
+
+void fkwrite(io_out io, const char* buf, size_t n)
+{
+    term_write(STDIO_OUTPUTS[io], buf, n);
+}
@@ -89,6 +89,19 @@ void term_prints(term_handle* h, const char* s)
     irq_unlock(f);
 }
 
+void term_write(term_handle* h, const char* buf, size_t n)
+{
+    irqlock_t f = irq_lock();
+
+    core_lock(&h->lock_);
+
+    for (size_t i = 0; i < n; i++)
+        putc(h, buf[i]);
+
+    core_unlock(&h->lock_);
+    irq_unlock(f);
+}
+
 
 static void putfmt(char c, void* args)
 {
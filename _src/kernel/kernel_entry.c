@@ -3,10 +3,13 @@
 #include <drivers/arm_generic_timer/arm_generic_timer.h>
 #include <drivers/interrupts/gicv3/gicv3.h>
 #include <drivers/tmu/tmu.h>
+#include <kernel/bench.h>
 #include <kernel/init.h>
 #include <kernel/lib/kvec.h>
 #include <kernel/mm.h>
 #include <kernel/panic.h>
+#include <kernel/percpu.h>
+#include <kernel/vtime.h>
 #include <lib/stdmacros.h>
 #include <lib/string.h>
 #include <stddef.h>
@@ -25,17 +28,35 @@ _Noreturn void kernel_entry()
     if (coreid == 0) {
         if (!mm_kernel_is_relocated())
             kernel_early_init();
-        else
+        else {
+            // the initcalls already use per core data
+            percpu_init_cpu(coreid);
             kernel_init();
+        }
     }
+    else
+        percpu_init_cpu(coreid);
 
     __attribute((unused)) mm_ksections y = MM_KSECTIONS;
 
 
     kprint("\n\rSTART\n\r");
 
-    scheduler_loop_cpu_enter();
-
-
-    loop asm volatile("wfi");
+    vtime_cpu_init();
+
+#ifdef BENCH
+    bench_cpu_init();
+#endif
+
+    // the scheduler returns when the core has nothing to run, it waits for the
+    // sgi sent when a thread is queued on it. The irqs stay masked from the
+    // check of the queues to the wfi, a sgi sent in between is left pending
+    // and still ends the wfi
+    loop {
+        arm_exceptions_disable(false, true, false, false);
+        scheduler_loop_cpu_enter();
+        DEBUG_ASSERT(arm_get_exception_level() == 1);
+        asm volatile("wfi");
+        arm_exceptions_enable(false, true, false, false);
+    }
 } /* kernel_entry */
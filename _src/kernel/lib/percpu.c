@@ -0,0 +1,28 @@
+#include <kernel/hardware.h>
+#include <kernel/percpu.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/panic.h"
+#include "lib/mem.h"
+
+
+DEFINE_PER_CPU(size_t, cpu_number);
+
+
+void percpu_init_cpu(size_t core)
+{
+    ASSERT(core < NUM_CORES);
+
+    if (core == 0) {
+        for (size_t i = 1; i < NUM_CORES; i++)
+            memcpy(
+                __percpu_start + i * PERCPU_SIZE,
+                __percpu_start,
+                PERCPU_SIZE);
+    }
+
+    asm volatile("msr tpidr_el1, %0" : : "r"(core * PERCPU_SIZE) : "memory");
+
+    *per_cpu_ptr(cpu_number, core) = core;
+}
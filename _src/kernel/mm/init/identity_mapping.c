@@ -29,7 +29,7 @@ static void* im_alloc(size_t bytes)
 
     memzero((void*)pa, bytes);
 
-    DEBUG_ASSERT(pa % MMU_GRANULARITY_4KB == 0);
+    DEBUG_ASSERT(pa % KPAGE_SIZE == 0);
 
     return (void*)pa;
 }
@@ -60,7 +60,7 @@ void early_identity_mapping()
 
     early_lo_mapping = mmu_mapping_new(
         MMU_LO,
-        MMU_GRANULARITY_4KB,
+        KPAGE_GRANULARITY,
         48,
         0x0,
         (void*)as_kpa((uintptr_t)im_alloc),
@@ -68,7 +68,7 @@ void early_identity_mapping()
 
     *pt_as_kpa(MM_MMU_KERNEL_MAPPING) = mmu_mapping_new(
         MMU_HI,
-        MMU_GRANULARITY_4KB,
+        KPAGE_GRANULARITY,
         48,
         0x0,
         (void*)as_kpa((uintptr_t)im_alloc),
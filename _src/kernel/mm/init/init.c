@@ -9,6 +9,7 @@
 #include "../malloc/raw_kmalloc/raw_kmalloc.h"
 #include "../mm_info.h"
 #include "../mm_mmu/mm_mmu.h"
+#include "../mm_mmu/pt_pool.h"
 #include "../phys/page_allocator.h"
 #include "../reloc/reloc.h"
 #include "../virt/vmalloc.h"
@@ -60,5 +61,7 @@ void mm_init()
 {
 	raw_kmalloc_init();
 
+	pt_pool_init();
+
 	cache_malloc_init();
 }
@@ -2,7 +2,7 @@
 
 import math
 
-PAGE_SIZE = 4096
+PAGE_SIZE = 4096  # KPAGE_SIZE
 UINT64_SIZE = 8
 PTR_SIZE = 8
 BITFIELD64_SIZE = 8
@@ -507,7 +507,7 @@ void cache_free(cache_malloc_size size, void* ptr)
 
 
 // this array must stay ordered from smaller to bigger
-static const size_t CACHE_PAGE_SIZES[2] = {4, 8};
+static const size_t CACHE_PAGE_SIZES[2] = {CACHE_8_PAGES, CACHE_1024_PAGES};
 
 bool cache_malloc_size_from_ptr(void* ptr, cache_malloc_size* out)
 {
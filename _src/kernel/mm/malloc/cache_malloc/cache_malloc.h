@@ -10,21 +10,24 @@
 
 #define CACHE_MALLOC_SUPPORTED_SIZES 8
 
-// pages per cache
+// pages per cache. Caches span 16KiB (32KiB for CACHE_1024) or a single page
+// if the kernel page is bigger
 #define STATIC_ASSERT_POW2(N)                                                  \
     _Static_assert(                                                            \
         ((N) & ((N) - 1)) == 0,                                                \
         "cache page count must be of order 2 as page_free relies on aligning " \
         "down to "                                                             \
         "the cache size and needs the va to be aligned to the size")
-#define CACHE_8_PAGES 4
-#define CACHE_16_PAGES 4
-#define CACHE_32_PAGES 4
-#define CACHE_64_PAGES 4
-#define CACHE_128_PAGES 4
-#define CACHE_256_PAGES 4
-#define CACHE_512_PAGES 4
-#define CACHE_1024_PAGES 8
+#define CACHE_BYTES_TO_PAGES(bytes) \
+    ((bytes) > KPAGE_SIZE ? (bytes) / KPAGE_SIZE : 1)
+#define CACHE_8_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_16_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_32_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_64_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_128_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_256_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_512_PAGES CACHE_BYTES_TO_PAGES(16 * MEM_KiB)
+#define CACHE_1024_PAGES CACHE_BYTES_TO_PAGES(32 * MEM_KiB)
 STATIC_ASSERT_POW2(CACHE_8_PAGES);
 STATIC_ASSERT_POW2(CACHE_16_PAGES);
 STATIC_ASSERT_POW2(CACHE_32_PAGES);
@@ -35,15 +38,20 @@ STATIC_ASSERT_POW2(CACHE_512_PAGES);
 STATIC_ASSERT_POW2(CACHE_1024_PAGES);
 
 
-// cache entries
-#define CACHE_8_ENTRIES 2014
-#define CACHE_16_ENTRIES 1015
-#define CACHE_32_ENTRIES 509
-#define CACHE_64_ENTRIES 255
-#define CACHE_128_ENTRIES 127
-#define CACHE_256_ENTRIES 63
-#define CACHE_512_ENTRIES 31
-#define CACHE_1024_ENTRIES 31
+// cache entries. The entries that fit in the cache pages after the prev/next
+// pointers and the reserved bitfields (same as buffers.py)
+#define CACHE_ENTRIES_FOR(size, pages)                                     \
+    (((pages) * KPAGE_SIZE - 16 -                                          \
+      8 * ((((pages) * KPAGE_SIZE - 16) / (size) + 63) / 64)) /            \
+     (size))
+#define CACHE_8_ENTRIES CACHE_ENTRIES_FOR(CACHE_8, CACHE_8_PAGES)
+#define CACHE_16_ENTRIES CACHE_ENTRIES_FOR(CACHE_16, CACHE_16_PAGES)
+#define CACHE_32_ENTRIES CACHE_ENTRIES_FOR(CACHE_32, CACHE_32_PAGES)
+#define CACHE_64_ENTRIES CACHE_ENTRIES_FOR(CACHE_64, CACHE_64_PAGES)
+#define CACHE_128_ENTRIES CACHE_ENTRIES_FOR(CACHE_128, CACHE_128_PAGES)
+#define CACHE_256_ENTRIES CACHE_ENTRIES_FOR(CACHE_256, CACHE_256_PAGES)
+#define CACHE_512_ENTRIES CACHE_ENTRIES_FOR(CACHE_512, CACHE_512_PAGES)
+#define CACHE_1024_ENTRIES CACHE_ENTRIES_FOR(CACHE_1024, CACHE_1024_PAGES)
 
 
 #define ENTRY_SIZE(cache_malloc_size) ((cache_malloc_size) / sizeof(uint64_t))
@@ -38,6 +38,9 @@ void reserve_malloc_init()
         ASSERT(pv.pa != 0 && ptrs_are_kmapped(pv));
         reserved_addr[i] = pv;
 
+        // the reserve backs the mmu tables, that must be zeroed
+        memzero64((void*)pv.va, KPAGE_SIZE);
+
         bitfield_set_high(reserved_pages, i);
     }
 
@@ -14,6 +14,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "../../mm_mmu/pt_pool.h"
 #include "../internal/reserve_malloc.h"
 
 
@@ -36,29 +37,53 @@ const raw_kmalloc_cfg RAW_KMALLOC_DYNAMIC_CFG = (raw_kmalloc_cfg) {
 };
 
 
-static const mmu_pg_cfg STD_MMU_KMEM_CFG = (mmu_pg_cfg) {
-    .attr_index = 0,
-    .ap = MMU_AP_EL0_NONE_EL1_RW,
-    .shareability = MMU_SH_INNER_SHAREABLE,
-    .non_secure = false,
-    .access_flag = 1,
-    .pxn = 0,
-    .uxn = 1,
-    .sw = 0,
-};
+#define STD_MMU_KMEM_CFG(mt)                    \
+    (mmu_pg_cfg) {                              \
+        .attr_index = (mt),                     \
+        .ap = MMU_AP_EL0_NONE_EL1_RW,           \
+        .shareability = MMU_SH_INNER_SHAREABLE, \
+        .non_secure = false,                    \
+        .access_flag = 1,                       \
+        .pxn = 0,                               \
+        .uxn = 1,                               \
+        .sw = 0,                                \
+    }
+
+#define STD_MMU_DEVICE_CFG(mt)                \
+    (mmu_pg_cfg) {                            \
+        .attr_index = (mt),                   \
+        .ap = MMU_AP_EL0_NONE_EL1_RW,         \
+        .shareability = MMU_SH_NON_SHAREABLE, \
+        .non_secure = false,                  \
+        .access_flag = 1,                     \
+        .pxn = 1,                             \
+        .uxn = 1,                             \
+        .sw = 0,                              \
+    }
 
-static const mmu_pg_cfg STD_MMU_DEVICE_CFG = (mmu_pg_cfg) {
-    .attr_index = 1,
-    .ap = MMU_AP_EL0_NONE_EL1_RW,
-    .shareability = MMU_SH_NON_SHAREABLE,
-    .non_secure = false,
-    .access_flag = 1,
-    .pxn = 1,
-    .uxn = 1,
-    .sw = 0,
+static const mmu_pg_cfg STD_MMU_CFGS[MMU_MT_COUNT] = {
+    [MMU_MT_NORMAL_WB] = STD_MMU_KMEM_CFG(MMU_MT_NORMAL_WB),
+    [MMU_MT_DEVICE_NGNRE] = STD_MMU_DEVICE_CFG(MMU_MT_DEVICE_NGNRE),
+    [MMU_MT_NORMAL_NC] = STD_MMU_KMEM_CFG(MMU_MT_NORMAL_NC),
+    [MMU_MT_NORMAL_WT] = STD_MMU_KMEM_CFG(MMU_MT_NORMAL_WT),
+    [MMU_MT_DEVICE_NGNRNE] = STD_MMU_DEVICE_CFG(MMU_MT_DEVICE_NGNRNE),
 };
 
 
+static inline mmu_memory_type mem_type_from_cfg(const raw_kmalloc_cfg* cfg)
+{
+    if (cfg->device_mem && cfg->mem_type == MMU_MT_NORMAL_WB)
+        return MMU_MT_DEVICE_NGNRE;
+
+    ASSERT(cfg->mem_type < MMU_MT_COUNT);
+    ASSERT(
+        cfg->device_mem == mmu_memory_type_is_device(cfg->mem_type),
+        "raw_kmalloc: device_mem does not match the memory type");
+
+    return cfg->mem_type;
+}
+
+
 static corelock_t lock;
 
 
@@ -69,6 +94,7 @@ vmalloc_cfg_from_raw_kmalloc_cfg(const raw_kmalloc_cfg* cfg, p_uintptr_t kmap_pa
         .assing_pa = cfg->assign_pa,
         .device_mem = cfg->device_mem,
         .permanent = cfg->permanent,
+        .mem_type = mem_type_from_cfg(cfg),
         .kmap =
             {
                 .use_kmap = cfg->kmap,
@@ -103,8 +129,9 @@ static void* raw_kmalloc_kmap(
 
     DEBUG_ASSERT(ptrs_are_kmapped(pv_ptr_new(pa, va)));
 
-    const mmu_pg_cfg* mmu_cfg =
-        cfg->device_mem ? &STD_MMU_DEVICE_CFG : &STD_MMU_KMEM_CFG;
+    const mmu_pg_cfg* mmu_cfg = &STD_MMU_CFGS[mem_type_from_cfg(cfg)];
+
+    pt_pool_prepare(MM_MMU_KERNEL_MAPPING, va, pages * KPAGE_SIZE);
 
     mmu_map_result mmu_res = mmu_map(
         MM_MMU_KERNEL_MAPPING,
@@ -135,8 +162,7 @@ static void* raw_kmalloc_dynamic(
     DEBUG_ASSERT(!cfg->kmap);
     ASSERT(cfg->assign_pa, "vmalloc: TODO: NOT IMPLEMENTED YET");
 
-    const mmu_pg_cfg* mmu_cfg =
-        cfg->device_mem ? &STD_MMU_DEVICE_CFG : &STD_MMU_KMEM_CFG;
+    const mmu_pg_cfg* mmu_cfg = &STD_MMU_CFGS[mem_type_from_cfg(cfg)];
 
     vmalloc_token vtoken;
     v_uintptr_t start =
@@ -168,6 +194,7 @@ static void* raw_kmalloc_dynamic(
         /*
          *  mmu map the pages
          */
+        pt_pool_prepare(MM_MMU_KERNEL_MAPPING, va, order_bytes);
 
         bool mmu_res =
             mmu_map(MM_MMU_KERNEL_MAPPING, va, pa, order_bytes, *mmu_cfg, NULL);
@@ -180,6 +207,10 @@ static void* raw_kmalloc_dynamic(
 
     DEBUG_ASSERT(start + (pages * KPAGE_SIZE) == va);
 
+    // the chunks were mapped one by one, tables they fill with contiguous pas
+    // become blocks. Nothing else uses the range before it is returned
+    mmu_promote(MM_MMU_KERNEL_MAPPING, start, pages * KPAGE_SIZE, NULL);
+
     if (info) {
         info->raw_kmalloc_type = RAW_KMALLOC_DYNAMIC;
         info->MMU_CFG = mmu_cfg;
@@ -217,8 +248,11 @@ void* __raw_kmalloc(
 
         DEBUG_ASSERT((v_uintptr_t)va % KPAGE_ALIGN == 0);
 
-        if (cfg->fill_reserve)
+        // the pool refill takes pages from the reserve, so it goes first
+        if (cfg->fill_reserve) {
+            pt_pool_fill();
             reserve_malloc_fill();
+        }
     }
 
     if (cfg->init_zeroed) {
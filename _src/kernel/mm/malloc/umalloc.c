@@ -22,6 +22,11 @@
 #define F_FULL_MAPPED 4
 #define F_PARTIALLY_MAPPED 5
 
+// mmu_pg_cfg.sw bits of the user pages
+#define SW_SHARED 0  // page of a block owned by another task (page_ref)
+#define SW_COW 1     // writable, write protected until the sharing is broken
+#define SW_PRIVATE 2 // copy made by a cow write fault, owned by the mapping
+
 
 #define BIT(bit) (1U << bit)
 
@@ -129,6 +134,30 @@ static void push_usr_region_to_task(utask* utask, usr_region region)
 }
 
 
+/// bitfield of the assigned pages of r, allocated on the first assignment of a
+/// big lazy region
+static bitfield64* assigned_bits(usr_region* r)
+{
+    if (r->any.pages <= 64)
+        return &r->sm.assigned_pa;
+
+    if (!r->bg.pt_assigned_pa) {
+        const size_t n = DIV_CEIL(r->any.pages, BITFIELD_CAPACITY(bitfield64));
+
+        r->bg.pt_assigned_pa = kmalloc(n * sizeof(bitfield64));
+        ASSERT(r->bg.pt_assigned_pa);
+
+        for (size_t i = 0; i < n; i++)
+            r->bg.pt_assigned_pa[i] = 0;
+    }
+
+    return r->bg.pt_assigned_pa;
+}
+
+
+/// assigns zeroed pages to [subregion_start, subregion_start + pages * page) of
+/// region, mapped in its kernel access and in the task. A page per block, so
+/// ufree can release them one by one
 static void umalloc_subregion(
     mmu_mapping* mapping,
     usr_region* region,
@@ -143,42 +172,39 @@ static void umalloc_subregion(
                 subregion_start + pages * KPAGE_SIZE,
         "umalloc_subregion: subregion out of region");
 
+    const mmu_pg_cfg usr_cfg = usr_mmu_cfg_from_flags(region->any.flags);
+    bitfield64* assigned = assigned_bits(region);
 
-    uintptr_t knl_subregion_start =
-        region->any.knl_start + (subregion_start - region->any.usr_start);
-
-    uint32_t remaining_pages = pages;
+    for (uint32_t i = 0; i < pages; i++) {
+        const uintptr_t usr_va = subregion_start + i * KPAGE_SIZE;
+        const uintptr_t offset = usr_va - region->any.usr_start;
+        const size_t idx = offset / KPAGE_SIZE;
+        void* kva = (void*)(region->any.knl_start + offset);
 
-    while (remaining_pages) {
-        uintptr_t offset = (pages - remaining_pages) * KPAGE_SIZE;
-        size_t order = log2_floor_u64(pages);
-
-        p_uintptr_t pa =
-            page_malloc(order, mm_page_data_new(tag, false, false));
+        p_uintptr_t pa = page_malloc(0, mm_page_data_new(tag, false, false));
 
         mmu_map_result mres;
         // map kernel access
         mres = mmu_map(
             MM_MMU_KERNEL_MAPPING,
-            knl_subregion_start + offset,
+            (v_uintptr_t)kva,
             pa,
-            power_of2(order),
+            KPAGE_SIZE,
             KNL_MMU_CFG,
             NULL);
         ASSERT(mres == MMU_MAP_OK);
 
+        // the task can not see the previous contents of the page
+        memzero(kva, KPAGE_SIZE);
+
         // map user access
-        mres = mmu_map(
-            mapping,
-            subregion_start + offset,
-            pa,
-            power_of2(order),
-            KNL_MMU_CFG,
-            NULL);
+        mres = mmu_map(mapping, usr_va, pa, KPAGE_SIZE, usr_cfg, NULL);
         ASSERT(mres == MMU_MAP_OK);
 
-        remaining_pages -= power_of2(order);
+        bitfield_set_high(assigned[idx / 64], idx % 64);
     }
+
+    SET_FLAG(region->any.flags, F_PARTIALLY_MAPPED, true);
 }
 
 
@@ -232,7 +258,8 @@ void* umalloc(
     if (pages > 64) {
         // big
         ur.bg.pt_assigned_pa =
-            kmalloc(DIV_CEIL(pages, BITFIELD_CAPACITY(bitfield64)));
+            kmalloc(DIV_CEIL(pages, BITFIELD_CAPACITY(bitfield64)) *
+                    sizeof(bitfield64));
 
         assigned_pa = ur.bg.pt_assigned_pa;
     }
@@ -260,7 +287,7 @@ void* umalloc(
             mapping,
             usr_va + offset,
             pa_info[i].pa,
-            pa_info[i].order * KPAGE_SIZE,
+            power_of2(pa_info[i].order) * KPAGE_SIZE,
             usr_mmu_cfg_from_flags(ur.any.flags),
             NULL);
 
@@ -268,7 +295,7 @@ void* umalloc(
 
 
         // mark the pages as allocated
-        size_t count = power_of2(pa_info->order);
+        size_t count = power_of2(pa_info[i].order);
         size_t idx = offset / KPAGE_SIZE;
 
         for (size_t j = 0; j < count; j++) {
@@ -288,43 +315,40 @@ void* umalloc(
 }
 
 
-void* umalloc_assign_pa(struct utask* t, uintptr_t usr_va, uint32_t pages)
+/// region of t that contains [usr_va, usr_va + size), NULL if none
+static usr_region_node*
+find_region(struct utask* t, uintptr_t usr_va, size_t size)
 {
-    // find the usr va node
-    usr_region_node* cur = t->regions;
+    for (usr_region_node* cur = t->regions; cur; cur = cur->next) {
+        const uintptr_t start = cur->region.any.usr_start;
+        const uintptr_t end = start + cur->region.any.pages * KPAGE_SIZE;
 
-    ASSERT(cur, "umalloc_assign_pa: task has no allocated regions");
-
-    uintptr_t start, end, cur_start, cur_end;
-    start = usr_va;
-    end = usr_va + pages * KPAGE_SIZE;
-
-    while (cur) {
-        cur_start = cur->region.any.usr_start;
-        cur_end =
-            cur->region.any.usr_start + cur->region.any.pages * KPAGE_SIZE;
-
-        if (cur_start <= start && cur_end >= end)
-            break;
-
-        cur = cur->next;
+        if (start <= usr_va && usr_va + size <= end)
+            return cur;
     }
 
-    ASSERT(
-        cur,
-        "umalloc_assign: no allocated region matches with the requested "
-        "subregion");
-    ASSERT(!GET_FLAG(cur->region.any.flags, F_FULL_MAPPED));
+    return NULL;
+}
+
 
+/// assigns pages to a subregion of the lazy region r, reserving its kernel
+/// access first if it has none
+static void assign_pages(
+    struct utask* t,
+    usr_region* r,
+    uintptr_t usr_va,
+    uint32_t pages)
+{
+    DEBUG_ASSERT(!GET_FLAG(r->any.flags, F_FULL_MAPPED));
 
     // if the region has no subregions assigned, it does not have a kernel
     // access to the region allocated with vmalloc
-    if (cur->region.any.knl_start == 0) {
+    if (r->any.knl_start == 0) {
         // reserve the kernel virtual region (all the region, not only the
         // subregion)
         vmalloc_token vtoken;
-        cur->region.any.knl_start = vmalloc(
-            cur->region.any.pages,
+        r->any.knl_start = vmalloc(
+            r->any.pages,
             "usr task region kernel access",
             (vmalloc_cfg) {
                 .kmap =
@@ -339,7 +363,21 @@ void* umalloc_assign_pa(struct utask* t, uintptr_t usr_va, uint32_t pages)
             &vtoken);
     }
 
-    umalloc_subregion(&t->mapping, &cur->region, t->task_name, usr_va, pages);
+    umalloc_subregion(&t->mapping, r, t->task_name, usr_va, pages);
+}
+
+
+void* umalloc_assign_pa(struct utask* t, uintptr_t usr_va, uint32_t pages)
+{
+    usr_region_node* cur = find_region(t, usr_va, pages * KPAGE_SIZE);
+
+    ASSERT(
+        cur,
+        "umalloc_assign: no allocated region matches with the requested "
+        "subregion");
+    ASSERT(!GET_FLAG(cur->region.any.flags, F_FULL_MAPPED));
+
+    assign_pages(t, &cur->region, usr_va, pages);
 
     size_t offset = usr_va - cur->region.any.usr_start;
 
@@ -347,6 +385,132 @@ void* umalloc_assign_pa(struct utask* t, uintptr_t usr_va, uint32_t pages)
 }
 
 
+void umalloc_share_pa(struct utask* t, uintptr_t usr_va, p_uintptr_t pa)
+{
+    usr_region_node* cur = find_region(t, usr_va, KPAGE_SIZE);
+
+    ASSERT(cur, "umalloc_share_pa: no region contains the page");
+    ASSERT(!GET_FLAG(cur->region.any.flags, F_FULL_MAPPED));
+    DEBUG_ASSERT(usr_va % KPAGE_SIZE == 0 && pa % KPAGE_SIZE == 0);
+    DEBUG_ASSERT(!mmu_translate(&t->mapping, usr_va).mapped);
+
+    mmu_pg_cfg cfg = usr_mmu_cfg_from_flags(cur->region.any.flags);
+    SET_FLAG(cfg.sw, SW_SHARED, true);
+
+    // the page of the owner is never written, copied on the first write
+    if (cfg.ap == MMU_AP_EL0_RW_EL1_RW) {
+        cfg.ap = MMU_AP_EL0_RO_EL1_RO;
+        SET_FLAG(cfg.sw, SW_COW, true);
+    }
+
+    page_ref(pa);
+
+    mmu_map_result mres =
+        mmu_map(&t->mapping, usr_va, pa, KPAGE_SIZE, cfg, NULL);
+    ASSERT(mres == MMU_MAP_OK);
+}
+
+
+/// assigns the page of va, and the unmapped ones that follow it up to
+/// UMALLOC_FAULT_AROUND, if a region of t allows the access. t->lock held
+static bool fault_in(struct utask* t, v_uintptr_t va, bool write, bool exec)
+{
+    usr_region_node* cur = find_region(t, va, KPAGE_SIZE);
+
+    if (!cur)
+        return false;
+
+    usr_region* r = &cur->region;
+    const uint32_t flags = r->any.flags;
+
+    if (!GET_FLAG(flags, F_READ) || (write && !GET_FLAG(flags, F_WRITE)) ||
+        (exec && !GET_FLAG(flags, F_EXEC)) || GET_FLAG(flags, F_FULL_MAPPED))
+        return false;
+
+    // another thread of the task assigned it first
+    if (mmu_translate(&t->mapping, va).mapped)
+        return true;
+
+    // a sequential access touches the next pages right after
+    const v_uintptr_t end = r->any.usr_start + r->any.pages * KPAGE_SIZE;
+    uint32_t pages = 1;
+
+    while (pages < UMALLOC_FAULT_AROUND && va + pages * KPAGE_SIZE < end &&
+           !mmu_translate(&t->mapping, va + pages * KPAGE_SIZE).mapped)
+        pages++;
+
+    assign_pages(t, r, va, pages);
+
+    return true;
+}
+
+
+bool umalloc_handle_translation_fault(
+    struct utask* t,
+    uintptr_t usr_va,
+    bool write,
+    bool exec)
+{
+    bool handled;
+
+    spinlocked(&t->lock)
+    {
+        handled = fault_in(t, align_down(usr_va, KPAGE_SIZE), write, exec);
+    }
+
+    return handled;
+}
+
+
+/// releases the pages of the region that the task does not own through its
+/// kernel access: shared pages of a clone and its cow copies
+static void release_cow_pages(struct utask* t, const usr_region* r)
+{
+    const v_uintptr_t end = r->any.usr_start + r->any.pages * KPAGE_SIZE;
+
+    for (v_uintptr_t va = r->any.usr_start; va < end; va += KPAGE_SIZE) {
+        mmu_translation tr = mmu_translate(&t->mapping, va);
+
+        if (!tr.mapped)
+            continue;
+
+        if (GET_FLAG(tr.cfg.sw, SW_SHARED))
+            page_unref(tr.pa);
+        else if (GET_FLAG(tr.cfg.sw, SW_PRIVATE))
+            raw_kfree(kpa_to_kva_pt(tr.pa));
+    }
+}
+
+
+/// frees the pages the region owns through its kernel access, and the access.
+/// The pages still shared with a clone are freed by its last page_unref
+static void release_owned_pages(const usr_region* r)
+{
+    if (r->any.knl_start == 0)
+        return;
+
+    // the pages and the access come from the same raw_kmalloc
+    if (GET_FLAG(r->any.flags, F_PERMANENT))
+        return raw_kfree((void*)r->any.knl_start);
+
+    const size_t bytes = r->any.pages * KPAGE_SIZE;
+
+    // the kernel mapping is active in every core, the hardware walks it
+    for (size_t off = 0; off < bytes; off += KPAGE_SIZE) {
+        p_uintptr_t pa;
+
+        if (mmu_translate_current(r->any.knl_start + off, &pa))
+            page_free(pa);
+    }
+
+    mmu_unmap_result ures =
+        mmu_unmap(MM_MMU_KERNEL_MAPPING, r->any.knl_start, bytes, NULL);
+    ASSERT(ures);
+
+    vfree((void*)r->any.knl_start, NULL);
+}
+
+
 void ufree(struct utask* t, uintptr_t usr_va)
 {
     usr_region_node* cur = t->regions;
@@ -361,10 +525,15 @@ void ufree(struct utask* t, uintptr_t usr_va)
             else
                 t->regions = cur->next;
 
+            release_cow_pages(t, &cur->region);
+
             mmu_unmap_result ures =
                 mmu_unmap(&t->mapping, usr_va, pages * KPAGE_SIZE, NULL);
             ASSERT(ures);
 
+            // after the task can not reach them anymore
+            release_owned_pages(&cur->region);
+
             // free the allocated bitfield64 array if it is a big region
             if (cur->region.any.pages > 64 &&
                 cur->region.bg.pt_assigned_pa != NULL)
@@ -381,3 +550,297 @@ void ufree(struct utask* t, uintptr_t usr_va)
 
     PANIC("ufree: region not found");
 }
+
+
+bool umalloc_region_exists(struct utask* t, uintptr_t usr_va, size_t size)
+{
+    for (usr_region_node* cur = t->regions; cur; cur = cur->next) {
+        const uintptr_t start = cur->region.any.usr_start;
+        const uintptr_t end = start + cur->region.any.pages * KPAGE_SIZE;
+
+        if (usr_va < end && start < usr_va + size)
+            return true;
+    }
+
+    return false;
+}
+
+
+bool umalloc_region_is(struct utask* t, uintptr_t usr_va, uint32_t pages)
+{
+    for (usr_region_node* cur = t->regions; cur; cur = cur->next)
+        if (cur->region.any.usr_start == usr_va)
+            return cur->region.any.pages == pages;
+
+    return false;
+}
+
+
+bool umalloc_protect(
+    struct utask* t,
+    uintptr_t usr_va,
+    uint32_t pages,
+    bool read,
+    bool write,
+    bool execute)
+{
+    if (!umalloc_region_is(t, usr_va, pages))
+        return false;
+
+    usr_region_node* cur = find_region(t, usr_va, pages * KPAGE_SIZE);
+
+    usr_region* r = &cur->region;
+
+    SET_FLAG(r->any.flags, F_READ, read);
+    SET_FLAG(r->any.flags, F_WRITE, write);
+    SET_FLAG(r->any.flags, F_EXEC, execute);
+
+    const mmu_pg_cfg base = usr_mmu_cfg_from_flags(r->any.flags);
+    const v_uintptr_t end = usr_va + pages * KPAGE_SIZE;
+
+    for (v_uintptr_t va = usr_va; va < end; va += KPAGE_SIZE) {
+        mmu_translation tr = mmu_translate(&t->mapping, va);
+
+        if (!tr.mapped)
+            continue;
+
+        mmu_pg_cfg cfg = base;
+        cfg.sw = tr.cfg.sw;
+
+        // a shared page stays write protected, copied on the first write. A
+        // read only one must not be made writable by the write fault
+        const bool shared = GET_FLAG(cfg.sw, SW_SHARED) ||
+                            GET_FLAG(cfg.sw, SW_COW) || page_refs(tr.pa) != 0;
+
+        SET_FLAG(cfg.sw, SW_COW, write && shared);
+
+        if (write && shared)
+            cfg.ap = MMU_AP_EL0_RO_EL1_RO;
+
+        mmu_map_result mres = mmu_map(
+            &t->mapping,
+            va,
+            align_down(tr.pa, KPAGE_SIZE),
+            KPAGE_SIZE,
+            cfg,
+            NULL);
+        ASSERT(mres == MMU_MAP_OK);
+    }
+
+    return true;
+}
+
+
+/// shares the mapped pages of the region of src with dst, write protecting the
+/// writable ones in both mappings
+static void clone_region_pages(
+    struct utask* dst,
+    struct utask* src,
+    const usr_region* r)
+{
+    const v_uintptr_t end = r->any.usr_start + r->any.pages * KPAGE_SIZE;
+    v_uintptr_t va = r->any.usr_start;
+
+    while (va < end) {
+        mmu_translation tr = mmu_translate(&src->mapping, va);
+
+        if (!tr.mapped) {
+            va += KPAGE_SIZE;
+            continue;
+        }
+
+        // the whole run mapped by the same descriptor is shared at once
+        size_t bytes = tr.leaf_bytes - (va % tr.leaf_bytes);
+        if (bytes > end - va)
+            bytes = end - va;
+
+        for (size_t off = 0; off < bytes; off += KPAGE_SIZE)
+            page_ref(tr.pa + off);
+
+        const bool writable = tr.cfg.ap == MMU_AP_EL0_RW_EL1_RW ||
+                              GET_FLAG(tr.cfg.sw, SW_COW);
+
+        mmu_pg_cfg cfg = tr.cfg;
+
+        if (writable) {
+            cfg.ap = MMU_AP_EL0_RO_EL1_RO;
+            SET_FLAG(cfg.sw, SW_COW, true);
+        }
+
+        if (tr.cfg.ap != cfg.ap || tr.cfg.sw != cfg.sw) {
+            mmu_map_result mres =
+                mmu_map(&src->mapping, va, tr.pa, bytes, cfg, NULL);
+            ASSERT(mres == MMU_MAP_OK);
+        }
+
+        SET_FLAG(cfg.sw, SW_SHARED, true);
+        SET_FLAG(cfg.sw, SW_PRIVATE, false);
+
+        mmu_map_result mres =
+            mmu_map(&dst->mapping, va, tr.pa, bytes, cfg, NULL);
+        ASSERT(mres == MMU_MAP_OK);
+
+        va += bytes;
+    }
+}
+
+
+void umalloc_clone_cow(struct utask* dst, struct utask* src)
+{
+    DEBUG_ASSERT(dst->regions == NULL);
+
+    for (usr_region_node* cur = src->regions; cur; cur = cur->next) {
+        usr_region r = cur->region;
+
+        // the kernel access belongs to src, dst gets its own one if it ever
+        // assigns new pages to the region
+        r.any.knl_start = 0;
+
+        if (r.any.pages > 64 && r.bg.pt_assigned_pa) {
+            const size_t n =
+                DIV_CEIL(r.any.pages, BITFIELD_CAPACITY(bitfield64));
+
+            r.bg.pt_assigned_pa = kmalloc(n * sizeof(bitfield64));
+
+            for (size_t i = 0; i < n; i++)
+                r.bg.pt_assigned_pa[i] = cur->region.bg.pt_assigned_pa[i];
+        }
+
+        push_usr_region_to_task(dst, r);
+        clone_region_pages(dst, src, &r);
+    }
+}
+
+
+/// breaks the sharing of the cow page at va. t->lock held, so two threads
+/// faulting on the same page do not both copy and release it
+static bool write_fault_locked(struct utask* t, v_uintptr_t va)
+{
+    mmu_translation tr = mmu_translate(&t->mapping, va);
+
+    // already handled by another thread of the task
+    if (tr.mapped && !GET_FLAG(tr.cfg.sw, SW_COW) &&
+        tr.cfg.ap == MMU_AP_EL0_RW_EL1_RW)
+        return true;
+
+    if (!tr.mapped || !GET_FLAG(tr.cfg.sw, SW_COW))
+        return false;
+
+    mmu_pg_cfg cfg = tr.cfg;
+    cfg.ap = MMU_AP_EL0_RW_EL1_RW;
+    SET_FLAG(cfg.sw, SW_COW, false);
+
+    mmu_map_result mres;
+
+    // owned page that nobody else maps anymore, just make it writable again.
+    // The refs are counted by block, so it can copy while not needed
+    if (!GET_FLAG(tr.cfg.sw, SW_SHARED) && page_refs(tr.pa) == 0) {
+        mres = mmu_map(&t->mapping, va, tr.pa, KPAGE_SIZE, cfg, NULL);
+        ASSERT(mres == MMU_MAP_OK);
+        return true;
+    }
+
+    raw_kmalloc_info info;
+    void* copy = raw_kmalloc(1, t->task_name, &RAW_KMALLOC_KMAP_CFG, &info);
+
+    if (!copy)
+        return false;
+
+    // the faulting task mapping is the active one, so the page can be read
+    // through its user va
+    memcpy64_aligned(copy, (void*)va, KPAGE_SIZE);
+
+    SET_FLAG(cfg.sw, SW_SHARED, false);
+    SET_FLAG(cfg.sw, SW_PRIVATE, true);
+
+    mres = mmu_map(
+        &t->mapping,
+        va,
+        info.info.kmap.pv.pa,
+        KPAGE_SIZE,
+        cfg,
+        NULL);
+    ASSERT(mres == MMU_MAP_OK);
+
+    if (GET_FLAG(tr.cfg.sw, SW_SHARED))
+        page_unref(tr.pa);
+    else if (GET_FLAG(tr.cfg.sw, SW_PRIVATE))
+        raw_kfree(kpa_to_kva_pt(tr.pa)); // the clones keep it until unref
+
+    return true;
+}
+
+
+bool umalloc_handle_write_fault(struct utask* t, uintptr_t usr_va)
+{
+    bool handled;
+
+    spinlocked(&t->lock)
+    {
+        handled = write_fault_locked(t, align_down(usr_va, KPAGE_SIZE));
+    }
+
+    return handled;
+}
+
+
+bool umalloc_user_readable(struct utask* t, uintptr_t usr_va, size_t size)
+{
+    if (size == 0)
+        return true;
+
+    // overflows and kernel addresses
+    if (usr_va + size < usr_va || is_kva_uintptr_t(usr_va + size - 1))
+        return false;
+
+    const v_uintptr_t end = usr_va + size;
+    v_uintptr_t va = align_down(usr_va, KPAGE_SIZE);
+
+    while (va < end) {
+        mmu_translation tr = mmu_translate(&t->mapping, va);
+
+        // a lazy page not touched yet
+        if (!tr.mapped && umalloc_handle_translation_fault(t, va, false, false))
+            tr = mmu_translate(&t->mapping, va);
+
+        if (!tr.mapped || (tr.cfg.ap != MMU_AP_EL0_RW_EL1_RW &&
+                           tr.cfg.ap != MMU_AP_EL0_RO_EL1_RO))
+            return false;
+
+        // the rest of the run mapped by the same descriptor
+        va += tr.leaf_bytes - (va % tr.leaf_bytes);
+    }
+
+    return true;
+}
+
+
+void* umalloc_user_kva(struct utask* t, uintptr_t usr_va)
+{
+    mmu_translation tr = mmu_translate(&t->mapping, usr_va);
+
+    if (!tr.mapped)
+        return NULL;
+
+    for (usr_region_node* cur = t->regions; cur; cur = cur->next) {
+        const usr_region* r = &cur->region;
+
+        if (usr_va < r->any.usr_start ||
+            usr_va >= r->any.usr_start + r->any.pages * KPAGE_SIZE)
+            continue;
+
+        if (r->any.knl_start == 0)
+            return NULL;
+
+        v_uintptr_t kva = r->any.knl_start + (usr_va - r->any.usr_start);
+        p_uintptr_t kpa;
+
+        // a cow copy or a page of the source of a clone maps another pa
+        if (!mmu_translate_current(kva, &kpa) || kpa != tr.pa)
+            return NULL;
+
+        return (void*)kva;
+    }
+
+    return NULL;
+}
@@ -8,10 +8,10 @@
 #include <stdint.h>
 
 #include "../init/mem_regions/early_kalloc.h"
-#include "../malloc/internal/reserve_malloc.h"
 #include "kernel/mm.h"
 #include "kernel/panic.h"
 #include "lib/mem.h"
+#include "pt_pool.h"
 
 mmu_mapping KERNEL_MAPPING;
 mmu_mapping UNMAPPED_LO;
@@ -22,39 +22,28 @@ mmu_mapping* const MM_MMU_UNMAPPED_LO = &UNMAPPED_LO;
 static mmu_core_handle handles[NUM_CORES];
 
 
-static void* mm_mmu_default_allocator(size_t bytes)
-{
-    (void)bytes;
-    DEBUG_ASSERT(bytes == KPAGE_SIZE);
-
-    pv_ptr pv = reserve_malloc("mmu table");
-
-    DEBUG_ASSERT(pv.pa % KPAGE_SIZE == 0);
-
-    return (void*)pv.va;
-}
-
-
 mmu_mapping mm_mmu_mapping_new(mmu_tbl_rng rng)
 {
     return mmu_mapping_new(
         rng,
-        MMU_GRANULARITY_4KB,
+        KPAGE_GRANULARITY,
         KERNEL_ADDR_BITS,
         KERNEL_BASE,
-        mm_mmu_default_allocator,
-        raw_kfree);
+        pt_pool_alloc,
+        pt_pool_free);
 }
 
 
 static void* unmapped_lo_allocator_first_tbl(size_t)
 {
     pv_ptr pv = early_kalloc(
-        MMU_GRANULARITY_4KB,
+        KPAGE_SIZE,
         "MM_MMU_UNMAPPED_LO table",
         true,
         false);
 
+    memzero((void*)pv.va, KPAGE_SIZE);
+
     return (void*)pv.va;
 }
 
@@ -67,7 +56,7 @@ void mm_mmu_early_init()
 {
     UNMAPPED_LO = mmu_mapping_new(
         MMU_LO,
-        MMU_GRANULARITY_4KB,
+        KPAGE_GRANULARITY,
         48,
         KERNEL_BASE,
         unmapped_lo_allocator_first_tbl,
@@ -0,0 +1,202 @@
+#include "pt_pool.h"
+
+#include <arm/mmu.h>
+#include <kernel/mm.h>
+#include <kernel/panic.h>
+#include <lib/math.h>
+#include <lib/mem.h>
+#include <lib/stdmacros.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../malloc/internal/reserve_malloc.h"
+#include "../malloc/raw_kmalloc/raw_kmalloc.h"
+
+
+static const char* PT_POOL_TAG = "mmu table";
+
+#define PT_POOL_SIZE 1024
+#define PT_POOL_MIN_WATERMARK 16
+const size_t PT_POOL_CAPACITY = PT_POOL_SIZE;
+
+
+static const raw_kmalloc_cfg PT_POOL_CFG = (raw_kmalloc_cfg) {
+    .assign_pa = true,
+    .fill_reserve = false,
+    .device_mem = false,
+    .permanent = false,
+    .kmap = true,
+    .init_zeroed = true,
+};
+
+
+static pv_ptr pool[PT_POOL_SIZE];
+static size_t count;
+
+static size_t low_watermark = PT_POOL_MIN_WATERMARK;
+// net tables taken since the last refill, and its peak
+static size_t used;
+static size_t peak_used;
+
+// the pool state is guarded by the raw_kmalloc lock, as the refills nest
+// raw_kmallocs
+static bool ready;
+static bool filling;
+
+
+static inline size_t high_watermark()
+{
+    return min(2 * low_watermark, PT_POOL_SIZE);
+}
+
+
+/// grows the watermark so the biggest burst since the last refill fits above
+/// it, or slowly decays it if the bursts got smaller
+static void adapt_watermark()
+{
+    const size_t want = 2 * peak_used;
+
+    if (want > low_watermark)
+        low_watermark = min(want, PT_POOL_SIZE / 2);
+    else
+        low_watermark = max((low_watermark + want) / 2, PT_POOL_MIN_WATERMARK);
+
+    used = 0;
+    peak_used = 0;
+}
+
+
+/// the nested raw_kmalloc can take tables from the pool itself, that is why the
+/// target is checked on every iteration
+static void fill_to(size_t target)
+{
+    DEBUG_ASSERT(target <= PT_POOL_SIZE);
+
+    filling = true;
+
+    while (count < target) {
+        v_uintptr_t va = (v_uintptr_t)raw_kmalloc(1, PT_POOL_TAG, &PT_POOL_CFG);
+
+        DEBUG_ASSERT(va % KPAGE_SIZE == 0);
+
+        pool[count++] = pv_ptr_new(kva_to_kpa(va), va);
+    }
+
+    filling = false;
+}
+
+
+void pt_pool_init()
+{
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    count = 0;
+    used = 0;
+    peak_used = 0;
+    low_watermark = PT_POOL_MIN_WATERMARK;
+    ready = true;
+
+    fill_to(high_watermark());
+}
+
+
+void* pt_pool_alloc(size_t bytes)
+{
+    (void)bytes;
+    DEBUG_ASSERT(bytes == KPAGE_SIZE);
+
+    pv_ptr pv;
+
+    // before the pool init the raw_kmalloc lock is not initialized either
+    if (!ready) {
+        pv = reserve_malloc(PT_POOL_TAG);
+        DEBUG_ASSERT(pv.pa % KPAGE_SIZE == 0);
+        return (void*)pv.va;
+    }
+
+    raw_kmalloc_lock();
+
+    if (count > 0) {
+        pv = pool[--count];
+
+        if (++used > peak_used)
+            peak_used = used;
+    }
+    // drained mid walk, the reserve covers it until the next refill
+    else
+        pv = reserve_malloc(PT_POOL_TAG);
+
+    raw_kmalloc_unlock(NULL);
+
+    DEBUG_ASSERT(pv.pa % KPAGE_SIZE == 0);
+
+    return (void*)pv.va;
+}
+
+
+void pt_pool_free(void* addr)
+{
+    bool pooled = false;
+
+    // tables freed before the pool init come from early_kalloc or the reserve,
+    // and raw_kfree is not usable yet. They are just leaked
+    if (!ready)
+        return;
+
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    if (count < high_watermark()) {
+        memzero64(addr, KPAGE_SIZE);
+
+        pool[count++] =
+            pv_ptr_new(kva_to_kpa((v_uintptr_t)addr), (v_uintptr_t)addr);
+        pooled = true;
+
+        if (used > 0)
+            used--;
+    }
+
+    if (!pooled)
+        raw_kfree(addr);
+}
+
+
+void pt_pool_fill()
+{
+    if (!ready)
+        return;
+
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    if (filling || count >= low_watermark)
+        return;
+
+    adapt_watermark();
+    fill_to(high_watermark());
+}
+
+
+void pt_pool_prepare(const mmu_mapping* m, v_uintptr_t va, size_t size)
+{
+    if (!ready)
+        return;
+
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    if (filling)
+        return;
+
+    const size_t needed = min(mmu_map_max_tbls(m, va, size), PT_POOL_SIZE);
+
+    if (count < needed)
+        fill_to(max(needed, high_watermark()));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <arm/mmu.h>
+#include <lib/mem.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ *  Page table pool. Keeps pre-zeroed kmapped pages for the tables of the
+ * mappings created with mm_mmu_mapping_new(), so mmu_map never has to zero or
+ * allocate through the general allocators in the middle of a walk. It is
+ * refilled in batches at safe points (after a raw_kmalloc), up to twice a low
+ * watermark that adapts to the biggest burst of tables consumed between
+ * refills. When drained, it falls back to the reserve allocator.
+ */
+
+
+extern const size_t PT_POOL_CAPACITY;
+
+
+void pt_pool_init();
+
+/// mmu_allocator of the kernel mappings
+void* pt_pool_alloc(size_t bytes);
+
+/// mmu_allocator_free of the kernel mappings
+void pt_pool_free(void* addr);
+
+/// refills the pool if it is under the low watermark
+void pt_pool_fill();
+
+/// makes sure the pool holds at least the tables needed for mapping the range
+/// in m (up to PT_POOL_CAPACITY). Must be called before mapping big ranges, as
+/// the pool can not be refilled during mmu_map
+void pt_pool_prepare(const mmu_mapping* m, v_uintptr_t va, size_t size);
@@ -24,6 +24,14 @@ typedef uint32_t node_data;
 #define FREE_SHIFT 8
 #define FREE_BITS 1
 
+// first page of an allocated block
+#define HEAD_SHIFT 9
+#define HEAD_BITS 1
+
+// freed by its owner while still shared, page_unref frees it
+#define ORPHAN_SHIFT 10
+#define ORPHAN_BITS 1
+
 #define UNSHIFTED_MASK(bit_n) ((1U << (bit_n)) - 1)
 #define MASK(bit_n, shift) (UNSHIFTED_MASK(bit_n) << shift)
 
@@ -35,6 +43,9 @@ typedef struct page_node {
     uint32_t next;
     uint32_t prev;
     node_data node_data;
+    // only for block heads. Shared page mappings of any page of the block that
+    // are not owned by the block owner (fits in the padding of the struct)
+    uint32_t refs;
     mm_page_data page_data;
 } page_node;
 
@@ -48,6 +59,9 @@ static inline void set_order(page_node* n, uint8_t o);
 static inline bool get_free(page_node* n);
 static inline void set_free(page_node* n, bool v);
 
+static inline bool get_flag(page_node* n, uint8_t shift);
+static inline void set_flag(page_node* n, uint8_t shift, bool v);
+
 static inline page_node* get_node(uint32_t i);
 
 static inline bool is_in_order_free_list(uint32_t i, uint8_t o);
@@ -115,6 +129,18 @@ static inline void set_free(page_node* n, bool v)
 }
 
 
+static inline bool get_flag(page_node* n, uint8_t shift)
+{
+    return (n->node_data >> shift) & 1U;
+}
+
+static inline void set_flag(page_node* n, uint8_t shift, bool v)
+{
+    n->node_data &= ~MASK(1, shift);
+    n->node_data |= (node_data)v << shift;
+}
+
+
 static inline page_node* get_node(uint32_t i)
 {
     DEBUG_ASSERT(i < N);
@@ -291,6 +317,8 @@ p_uintptr_t page_malloc(uint8_t order, mm_page_data p)
                 split_to_order_and_pop(i, order);
                 n = get_node(i);
                 n->page_data = p;
+                n->refs = 0;
+                set_flag(n, HEAD_SHIFT, true);
                 return i * KPAGE_SIZE;
             }
         }
@@ -302,6 +330,8 @@ p_uintptr_t page_malloc(uint8_t order, mm_page_data p)
     remove_from_list(i);
 
     n->page_data = p;
+    n->refs = 0;
+    set_flag(n, HEAD_SHIFT, true);
 
     return i * KPAGE_SIZE;
 }
@@ -322,11 +352,82 @@ void page_free(p_uintptr_t pa)
     if (is_inner_idx(i))
         PANIC("page_free: invalid pa provided");
 
+    DEBUG_ASSERT(get_flag(n, HEAD_SHIFT));
+
+    // still mapped by other tasks, the last page_unref frees it
+    if (n->refs > 0) {
+        set_flag(n, ORPHAN_SHIFT, true);
+        return;
+    }
+
+    set_flag(n, HEAD_SHIFT, false);
+    set_flag(n, ORPHAN_SHIFT, false);
+
     push_to_list(i);
     try_merge(i);
 }
 
 
+/// head of the allocated block that contains the page i
+static uint32_t block_head(uint32_t i)
+{
+    for (uint8_t k = 0; k <= MAX_ORDER; k++) {
+        uint32_t base = parent_at_order(i, k);
+        page_node* n = get_node(base);
+
+        if (get_flag(n, HEAD_SHIFT) && get_order(n) >= k)
+            return base;
+    }
+
+    PANIC("block_head: the page is not allocated");
+}
+
+
+void page_ref(p_uintptr_t pa)
+{
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    page_node* n = get_node(block_head(pa / KPAGE_SIZE));
+
+    ASSERT(!get_flag(n, ORPHAN_SHIFT), "page_ref: the block was freed");
+    ASSERT(n->refs != UINT32_MAX);
+
+    n->refs++;
+}
+
+
+bool page_unref(p_uintptr_t pa)
+{
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    uint32_t i = block_head(pa / KPAGE_SIZE);
+    page_node* n = get_node(i);
+
+    ASSERT(n->refs > 0, "page_unref: the page is not shared");
+
+    if (--n->refs > 0 || !get_flag(n, ORPHAN_SHIFT))
+        return false;
+
+    page_free(i * KPAGE_SIZE);
+
+    return true;
+}
+
+
+uint32_t page_refs(p_uintptr_t pa)
+{
+    raw_kmalloc_lock();
+    __attribute__((cleanup(raw_kmalloc_unlock))) int __defer
+        __attribute__((unused));
+
+    return get_node(block_head(pa / KPAGE_SIZE))->refs;
+}
+
+
 const char* page_allocator_update_tag(p_uintptr_t pa, const char* new_tag)
 {
     uint32_t i = pa / KPAGE_SIZE;
@@ -464,6 +565,7 @@ void page_allocator_init()
             .next = NULL_IDX,
             .prev = NULL_IDX,
             .node_data = 0,
+            .refs = 0,
             .page_data = {0},
         };
     }
@@ -507,6 +609,7 @@ void page_allocator_update_memregs(const early_memreg* mregs, size_t n)
                 o--;
 
             reserve(j, o);
+            set_flag(get_node(j), HEAD_SHIFT, true);
             get_node(j)->page_data = (mm_page_data) {
                 .tag = e.tag,
                 .permanent = e.permanent,
@@ -169,7 +169,7 @@ rva_node* get_new_rva_node()
 
 void free_fva_node(fva_node* node)
 {
-    // get container by aligning down to 4096
+    // get container by aligning down to KPAGE_SIZE
     vmalloc_container* container =
         (vmalloc_container*)((v_uintptr_t)node & ~(KPAGE_SIZE - 1ULL));
 
@@ -205,7 +205,7 @@ void free_fva_node(fva_node* node)
 
 void free_rva_node(rva_node* node)
 {
-    // get container by aligning down to 4096
+    // get container by aligning down to KPAGE_SIZE
     vmalloc_container* container =
         (vmalloc_container*)((v_uintptr_t)node & ~(KPAGE_SIZE - 1ULL));
 
@@ -33,8 +33,16 @@ typedef struct rva_node {
 } rva_node;
 
 
-#define FVA_NODE_COUNT (DATA_BYTES / sizeof(fva_node) - 1)
-#define RVA_NODE_COUNT (DATA_BYTES / sizeof(rva_node) - 1)
+// nodes that fit in DATA_BYTES after the reserved bitfield. The bitfield is
+// sized for the nodes that would fit without it, so it always has room
+#define BF_BYTES_FOR(N)                                    \
+    ((BITFIELD_COUNT_FOR(N, bf) * sizeof(bf) + DATA_ALIGN - 1) \
+     & ~(DATA_ALIGN - 1))
+#define NODE_COUNT_FOR(node_size) \
+    ((DATA_BYTES - BF_BYTES_FOR(DATA_BYTES / (node_size))) / (node_size))
+
+#define FVA_NODE_COUNT NODE_COUNT_FOR(sizeof(fva_node))
+#define RVA_NODE_COUNT NODE_COUNT_FOR(sizeof(rva_node))
 
 typedef struct {
     // bitfield that represents if a node is reserved (1) or free for
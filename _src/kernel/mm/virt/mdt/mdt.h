@@ -25,8 +25,13 @@ typedef struct {
 } vmalloc_mdt_container_hdr;
 
 
-#define PA_MDT_CONTAINER_NODES \
+#define PA_MDT_MAX_NODES \
     ((KPAGE_SIZE - sizeof(vmalloc_mdt_container_hdr)) / sizeof(vmalloc_pa_mdt))
+// leaves room for the reserved bitfield of the nodes
+#define PA_MDT_CONTAINER_NODES                                             \
+    ((KPAGE_SIZE - sizeof(vmalloc_mdt_container_hdr) -                     \
+      BITFIELD_COUNT_FOR(PA_MDT_MAX_NODES, mdt_bf) * sizeof(mdt_bf)) /     \
+     sizeof(vmalloc_pa_mdt))
 #define PA_MDT_BF_COUNT BITFIELD_COUNT_FOR(PA_MDT_CONTAINER_NODES, mdt_bf)
 
 typedef struct vmalloc_mdt_container {
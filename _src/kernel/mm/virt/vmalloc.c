@@ -128,6 +128,8 @@ v_uintptr_t vmalloc_update_memregs(const early_memreg* mregs, size_t n)
                 .assing_pa = true,
                 .device_mem = mb.device_memory,
                 .permanent = mb.permanent,
+                .mem_type = mb.device_memory ? MMU_MT_DEVICE_NGNRE
+                                             : MMU_MT_NORMAL_WB,
             });
     }
 
@@ -197,9 +199,29 @@ static v_uintptr_t reserve_from_fva_node(
 }
 
 
-static const size_t PAGE_L3 = MEM_KiB * 4;
-static const size_t PAGE_L2 = PAGE_L3 * 512;
-static const size_t PAGE_L1 = PAGE_L2 * 512;
+static char mem_type_char(mmu_memory_type t)
+{
+    switch (t) {
+        case MMU_MT_NORMAL_WB:
+            return '-';
+        case MMU_MT_DEVICE_NGNRE:
+            return 'D';
+        case MMU_MT_DEVICE_NGNRNE:
+            return 'S';
+        case MMU_MT_NORMAL_NC:
+            return 'W';
+        case MMU_MT_NORMAL_WT:
+            return 'T';
+        default:
+            return '?';
+    }
+}
+
+
+// bytes mapped by a descriptor of each level (a table holds KPAGE_SIZE / 8)
+static const size_t PAGE_L3 = KPAGE_SIZE;
+static const size_t PAGE_L2 = PAGE_L3 * (KPAGE_SIZE / sizeof(uint64_t));
+static const size_t PAGE_L1 = PAGE_L2 * (KPAGE_SIZE / sizeof(uint64_t));
 
 
 static inline bool dynamic_fits_page_aligned(
@@ -459,6 +481,7 @@ static rva_node* push_rva(
                         .pa_assigned = cfg.assing_pa,
                         .device_mem = cfg.device_mem,
                         .permanent = cfg.permanent,
+                        .mem_type = cfg.mem_type,
                     },
                 .pa_mdt =
                     {
@@ -856,7 +879,7 @@ void vmalloc_debug_reserved()
                 pages);
             kprintf("[%c", cur->mdt.info.kmapped ? 'K' : '-');
             kprintf("%c", cur->mdt.info.pa_assigned ? 'P' : '-');
-            kprintf("%c", cur->mdt.info.device_mem ? 'D' : '-');
+            kprintf("%c", mem_type_char(cur->mdt.info.mem_type));
             kprintf("%c]", cur->mdt.info.permanent ? '!' : '-');
 
             kprintf("\t%s\n\r", cur->mdt.info.tag);
@@ -3,6 +3,7 @@
 #include <arm/exceptions/exceptions.h>
 #include <arm/mmu.h>
 #include <kernel/io/stdio.h>
+#include <kernel/sched_trace.h>
 #include <lib/lock/spinlock_irq.h>
 #include <lib/stdmacros.h>
 #include <lib/string.h>
@@ -152,6 +153,10 @@ static void handle_panic(panic_info* info, panic_recovery recovery)
             break;
     }
 
+    // the last scheduling decisions of every core before the panic
+    fkprint(IO_STDPANIC, "\n[SCHED TRACE]\n");
+    sched_trace_dump(IO_STDPANIC);
+
     fkprint(IO_STDPANIC, ANSI_CLEAR);
 
     if (recovery == PANIC_UNRECOVERABLE)
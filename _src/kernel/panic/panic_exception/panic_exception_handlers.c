@@ -1,5 +1,6 @@
 #include "panic_exception_handlers.h"
 
+#include <arm/mmu.h>
 #include <arm/sysregs/sysregs.h>
 #include <kernel/io/stdio.h>
 #include <kernel/panic.h>
@@ -58,6 +59,19 @@ static void print_raw_sysregs(exception_reason_sysregs* sysregs)
 }
 
 
+/// where far is in the mappings of the core, read by the hardware walker as
+/// the tables may be the broken thing
+static void print_far_pa(const exception_reason_sysregs* sysregs)
+{
+    p_uintptr_t pa;
+
+    if (mmu_translate_current(sysregs->far, &pa))
+        fkprintf(IO_STDPANIC, "far pa: %p\n", pa);
+    else
+        fkprintf(IO_STDPANIC, "far pa: not mapped\n");
+}
+
+
 void handle_sync_panic(panic_exception_src src)
 {
     print_exception_src(src);
@@ -65,6 +79,7 @@ void handle_sync_panic(panic_exception_src src)
     exception_reason_sysregs sysregs = get_exception_reason_sysregs();
 
     print_raw_sysregs(&sysregs);
+    print_far_pa(&sysregs);
 
     print_esr(&sysregs, PANIC_EXCEPTION_TYPE_SYNC);
 }
@@ -0,0 +1,254 @@
+#include "elf.h"
+
+#include <arm/cache.h>
+#include <arm/mmu.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/mm.h"
+#include "kernel/panic.h"
+#include "lib/align.h"
+#include "lib/mem.h"
+
+
+#define EI_CLASS 4
+#define EI_DATA 5
+#define ELFCLASS64 2
+#define ELFDATA2LSB 1
+#define ET_EXEC 2
+#define EM_AARCH64 183
+
+#define PT_LOAD 1
+
+#define PF_X 1
+#define PF_W 2
+#define PF_R 4
+
+typedef struct {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf64_ehdr;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} elf64_phdr;
+
+// segments end under the stack, with an unmapped guard page between them
+#define ELF_STACK_BOTTOM (ELF_STACK_TOP - ELF_STACK_PAGES * KPAGE_SIZE)
+#define ELF_SEGMENTS_END (ELF_STACK_BOTTOM - KPAGE_SIZE)
+
+
+static inline bool is_loaded(const elf64_phdr* ph)
+{
+    return ph->p_type == PT_LOAD && ph->p_memsz != 0;
+}
+
+
+static inline uintptr_t seg_start(const elf64_phdr* ph)
+{
+    return align_down(ph->p_vaddr, KPAGE_SIZE);
+}
+
+
+static inline uintptr_t seg_end(const elf64_phdr* ph)
+{
+    return align_up(ph->p_vaddr + ph->p_memsz, KPAGE_SIZE);
+}
+
+
+static elf_load_result check_hdr(const uint8_t* elf, size_t size)
+{
+    if (size < sizeof(elf64_ehdr) || elf[0] != 0x7F || elf[1] != 'E' ||
+        elf[2] != 'L' || elf[3] != 'F')
+        return ELF_LOAD_BAD_MAGIC;
+
+    const elf64_ehdr* eh = (const elf64_ehdr*)elf;
+
+    if ((uintptr_t)elf % _Alignof(elf64_ehdr) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+        eh->e_ident[EI_DATA] != ELFDATA2LSB || eh->e_type != ET_EXEC ||
+        eh->e_machine != EM_AARCH64 ||
+        eh->e_phentsize != sizeof(elf64_phdr) || eh->e_phnum == 0 ||
+        eh->e_phoff % _Alignof(elf64_phdr) != 0 || eh->e_phoff > size ||
+        (size - eh->e_phoff) / sizeof(elf64_phdr) < eh->e_phnum)
+        return ELF_LOAD_BAD_HDR;
+
+    return ELF_LOAD_OK;
+}
+
+
+static elf_load_result
+check_segments(const elf64_ehdr* eh, const elf64_phdr* phs, size_t size)
+{
+    bool entry_ok = false;
+
+    for (size_t i = 0; i < eh->e_phnum; i++) {
+        const elf64_phdr* ph = &phs[i];
+
+        if (!is_loaded(ph))
+            continue;
+
+        if (ph->p_filesz > ph->p_memsz || ph->p_offset > size ||
+            ph->p_filesz > size - ph->p_offset ||
+            ph->p_memsz > ELF_SEGMENTS_END || ph->p_vaddr < KPAGE_SIZE ||
+            ph->p_vaddr > ELF_SEGMENTS_END - ph->p_memsz)
+            return ELF_LOAD_BAD_SEGMENT;
+
+        // umalloc regions are R, RW or RX
+        if (!(ph->p_flags & PF_R) ||
+            ((ph->p_flags & PF_W) && (ph->p_flags & PF_X)))
+            return ELF_LOAD_BAD_SEGMENT;
+
+        // each segment is a region, they can not share a page
+        for (size_t j = 0; j < i; j++)
+            if (is_loaded(&phs[j]) && seg_start(ph) < seg_end(&phs[j]) &&
+                seg_start(&phs[j]) < seg_end(ph))
+                return ELF_LOAD_BAD_SEGMENT;
+
+        if ((ph->p_flags & PF_X) && eh->e_entry >= ph->p_vaddr &&
+            eh->e_entry < ph->p_vaddr + ph->p_memsz)
+            entry_ok = true;
+    }
+
+    return entry_ok ? ELF_LOAD_OK : ELF_LOAD_BAD_HDR;
+}
+
+
+/// copies the file bytes of the segment from the user va from on to zeroed
+/// pages of the task
+static void copy_in(
+    utask* t,
+    const uint8_t* elf,
+    const elf64_phdr* ph,
+    uintptr_t from)
+{
+    const uintptr_t file_end = ph->p_vaddr + ph->p_filesz;
+    const uintptr_t first = from > ph->p_vaddr ? from : ph->p_vaddr;
+    const uint32_t pages =
+        (uint32_t)((align_up(file_end, KPAGE_SIZE) - from) / KPAGE_SIZE);
+
+    uint8_t* kva = umalloc_assign_pa(t, from, pages);
+
+    memcpy(
+        kva + (first - from),
+        elf + ph->p_offset + (first - ph->p_vaddr),
+        file_end - first);
+
+    // written through the kernel va, executed from the user one
+    if (ph->p_flags & PF_X)
+        _cache_flush_range(
+            (uintptr_t)kva,
+            (uintptr_t)kva + pages * KPAGE_SIZE);
+}
+
+
+/// maps the file bytes of the segment in the task. The pages of the image are
+/// shared if it is page aligned and the segment is at the same page offset in
+/// the image and in its va, else and for the page where the file bytes end
+/// they are copied, as the rest of that page must be zero
+static void map_segment(utask* t, const uint8_t* elf, const elf64_phdr* ph)
+{
+    const uintptr_t file_end = ph->p_vaddr + ph->p_filesz;
+    uintptr_t va = seg_start(ph);
+
+    if (ph->p_filesz == 0)
+        return;
+
+    const bool shareable = (uintptr_t)elf % KPAGE_SIZE == 0 &&
+                           (ph->p_vaddr - ph->p_offset) % KPAGE_SIZE == 0;
+
+    for (; shareable && va + KPAGE_SIZE <= file_end; va += KPAGE_SIZE) {
+        const uintptr_t kva =
+            (uintptr_t)elf + ph->p_offset - (ph->p_vaddr - va);
+        p_uintptr_t pa;
+        const bool mapped = mmu_translate_current(kva, &pa);
+
+        ASSERT(mapped, "elf_load: image page not mapped");
+
+        if (ph->p_flags & PF_X)
+            _cache_flush_range(kva, kva + KPAGE_SIZE);
+
+        umalloc_share_pa(t, va, align_down(pa, KPAGE_SIZE));
+    }
+
+    if (va < file_end)
+        copy_in(t, elf, ph, va);
+}
+
+
+elf_load_result
+elf_load(const void* elf, size_t size, const char* name, elf_task* out)
+{
+    const uint8_t* img = elf;
+
+    elf_load_result res = check_hdr(img, size);
+    if (res != ELF_LOAD_OK)
+        return res;
+
+    const elf64_ehdr* eh = elf;
+    const elf64_phdr* phs = (const elf64_phdr*)(img + eh->e_phoff);
+
+    res = check_segments(eh, phs, size);
+    if (res != ELF_LOAD_OK)
+        return res;
+
+    utask* t = utask_new(name);
+
+    for (size_t i = 0; i < eh->e_phnum; i++) {
+        const elf64_phdr* ph = &phs[i];
+
+        if (!is_loaded(ph))
+            continue;
+
+        // the pages not mapped by map_segment (bss) are zeroed on first access
+        umalloc(
+            t,
+            seg_start(ph),
+            (uint32_t)((seg_end(ph) - seg_start(ph)) / KPAGE_SIZE),
+            true,
+            ph->p_flags & PF_W,
+            ph->p_flags & PF_X,
+            false);
+
+        map_segment(t, img, ph);
+    }
+
+    umalloc(
+        t,
+        ELF_STACK_BOTTOM,
+        ELF_STACK_PAGES,
+        true,
+        true,
+        false,
+        false);
+
+    *out = (elf_task) {
+        .task = t,
+        .entry = eh->e_entry,
+        .sp = ELF_STACK_TOP,
+    };
+
+    return ELF_LOAD_OK;
+}
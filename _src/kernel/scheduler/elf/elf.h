@@ -1,11 +1,42 @@
 #pragma once
 
-#include <kernel/scheduler/process.h>
+#include <kernel/scheduler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Loader of static ELF64 aarch64 executables from an image in kernel memory.
+ *  Nothing is copied up front: the pages of the image are mapped in the task
+ *  (read only ones as they are, writable ones copied on the first write) and
+ *  the bss is assigned zeroed on the first access, so loading does not depend
+ *  on the size of the binary. The image must be in pages of the page allocator
+ *  (kernel sections or raw_kmalloc), each mapped one stays allocated while a
+ *  task maps it
+ */
+
+// lazy stack of the main thread, right under the vas of SYSC_MAP
+#ifndef ELF_STACK_PAGES
+#    define ELF_STACK_PAGES 16
+#endif
+#define ELF_STACK_TOP UTASK_MAP_BASE
 
 typedef enum {
     ELF_LOAD_OK,
     ELF_LOAD_BAD_MAGIC,
-    ELF_LOAD_BAD_HDR,
+    ELF_LOAD_BAD_HDR,     // not an ELF64 little endian aarch64 executable
+    ELF_LOAD_BAD_SEGMENT, // out of the image, overlapping or W + X
 } elf_load_result;
 
-elf_load_result elf_load(void* elf, size_t size, proc* usr_proc);
\ No newline at end of file
+typedef struct {
+    utask* task;
+    uint64_t entry;
+    uint64_t sp;
+} elf_task;
+
+
+/// Checks the image and builds a task named name with its segments and a
+/// stack. Returns ELF_LOAD_OK and the task in out, ready for
+/// scheduler_thread_new(out->task, out->entry, out->sp, arg). Nothing is built
+/// if the image is not valid
+elf_load_result
+elf_load(const void* elf, size_t size, const char* name, elf_task* out);
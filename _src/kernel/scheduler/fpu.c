@@ -0,0 +1,72 @@
+#include <arm/fpu.h>
+#include <kernel/fpu.h>
+#include <kernel/hardware.h>
+#include <kernel/percpu.h>
+#include <kernel/scheduler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/panic.h"
+
+
+// last thread that used the el0 fp registers of the core
+static DEFINE_PER_CPU(thread*, fp_owner);
+
+
+void fpu_kernel_claim(void)
+{
+    thread** owner = this_cpu_ptr(fp_owner);
+
+    if (!*owner)
+        return;
+
+    _ARM_fp_ctx_save(&(*owner)->fp);
+
+    // released after the save, another core can resume it from memory
+    __atomic_store_n(owner, NULL, __ATOMIC_RELEASE);
+
+    arm_set_fpen(ARM_FPEN_TRAP_EL0);
+}
+
+
+void fpu_switch_to(thread* th)
+{
+    thread** owner = this_cpu_ptr(fp_owner);
+
+    arm_set_fpen(*owner == th ? ARM_FPEN_TRAP_NONE : ARM_FPEN_TRAP_EL0);
+}
+
+
+void fpu_handle_trap(thread* th)
+{
+    thread** owner = this_cpu_ptr(fp_owner);
+
+    DEBUG_ASSERT(*owner != th);
+
+    if (*owner)
+        _ARM_fp_ctx_save(&(*owner)->fp);
+
+    _ARM_fp_ctx_restore(&th->fp);
+    __atomic_store_n(owner, th, __ATOMIC_RELEASE);
+
+    arm_set_fpen(ARM_FPEN_TRAP_NONE);
+}
+
+
+void fpu_release(thread* th)
+{
+    thread** owner = this_cpu_ptr(fp_owner);
+
+    if (*owner == th)
+        fpu_kernel_claim();
+}
+
+
+int64_t fpu_live_core(const thread* th)
+{
+    for (size_t i = 0; i < NUM_CORES; i++)
+        if (__atomic_load_n(per_cpu_ptr(fp_owner, i), __ATOMIC_ACQUIRE) == th)
+            return (int64_t)i;
+
+    return -1;
+}
@@ -1,12 +1,26 @@
+#include <arm/cpu.h>
 #include <arm/exceptions/exceptions.h>
+#include <arm/sysregs/arm_generic_timer.h>
 #include <arm/sysregs/sysregs.h>
+#include <drivers/arm_generic_timer/arm_generic_timer.h>
+#include <drivers/interrupts/gicv3/gicv3.h>
+#include <kernel/devices/drivers.h>
+#include <kernel/fpu.h>
 #include <kernel/hardware.h>
+#include <kernel/init.h>
 #include <kernel/lib/smp.h>
+#include <kernel/percpu.h>
+#include <kernel/sched_trace.h>
 #include <kernel/scheduler.h>
+#include <lib/lock/spinlock.h>
+#include <lib/lock/spinlock_irq.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "kernel/io/stdio.h"
+#include "kernel/mm.h"
+#include "kernel/panic.h"
 #include "thread.h"
 
 
@@ -21,17 +35,131 @@ extern void _scheduler_loop_cpu_exit(uint64_t el1_ctx[4]);
 
 typedef struct thread_node {
     struct thread_node *prev, *next;
+    uint8_t queued_prio; // list of the run queue it is linked in
     thread th;
 } thread_node;
 
 
 typedef struct {
-    _Alignas(CACHE_LINE) thread_node* list;
-} scheduler_t;
+    thread_node* head;
+    thread_node* tail;
+} rq_list;
 
 
-_Alignas(16) static uint64_t local_el1_ctx[NUM_CORES][4];
-static scheduler_t scheduler[NUM_CORES];
+/// Per core queues of the THREAD_READY threads, one fifo for the best effort
+/// class and one per real time priority. The running thread is not in them
+typedef struct {
+    _Alignas(CACHE_LINE) spinlock_t lock;
+    rq_list be;
+    rq_list rt[SCHED_RT_PRIOS];
+    uint32_t rt_bitmap; // bit p set if rt[p] is not empty
+    size_t nr_ready;
+    thread* running;
+    bool idle; // waiting in wfi for a sgi
+} runqueue_t;
+
+
+_Alignas(16) static DEFINE_PER_CPU(uint64_t, el1_ctx[4]);
+static DEFINE_PER_CPU(runqueue_t, runqueue);
+
+
+static inline runqueue_t* cpu_rq(size_t core)
+{
+    return per_cpu_ptr(runqueue, core);
+}
+
+
+/// Per core timer state. The comparator is only programmed for the next real
+/// deadline: the end of the quantum while other threads wait for the core, or
+/// the first timed sleeper. Only touched by its core with irqs masked
+typedef struct {
+    // cycles, end of the quantum. 0 while the tick is stopped
+    _Alignas(CACHE_LINE) uint64_t deadline;
+    uint64_t expired; // deadline of the last tick
+    bool need_resched;
+    thread* sleepers; // timed sleepers sorted by wake_at
+    scheduler_stats stats;
+} sched_tick_t;
+
+static DEFINE_PER_CPU(sched_tick_t, tick);
+static uint64_t quantum_us = SCHED_QUANTUM_US;
+
+
+static inline sched_tick_t* cpu_tick(size_t core)
+{
+    return per_cpu_ptr(tick, core);
+}
+
+
+static void enqueue(thread* th, size_t core);
+
+static void program_timer(size_t core)
+{
+    sched_tick_t* st = cpu_tick(core);
+    uint64_t next = st->deadline ? st->deadline : UINT64_MAX;
+
+    if (st->sleepers && st->sleepers->wake_at < next)
+        next = st->sleepers->wake_at;
+
+    // the virtual timer of the running core, the callers always program their
+    // own core
+    DEBUG_ASSERT(core == this_cpu_id());
+
+    if (next == UINT64_MAX) {
+        _ARM_CNTV_CTL_EL0_set(0);
+        return;
+    }
+
+    _ARM_CNTV_CVAL_EL0_set(next);
+    _ARM_CNTV_CTL_EL0_set(1);
+}
+
+
+/// Stops the tick while no other thread waits for the core, else arms the
+/// quantum if it was stopped or a new one starts
+static void tick_update(size_t core, bool new_quantum)
+{
+    sched_tick_t* st = cpu_tick(core);
+
+    if (__atomic_load_n(&cpu_rq(core)->nr_ready, __ATOMIC_RELAXED) == 0)
+        st->deadline = 0;
+    else if (new_quantum || st->deadline == 0) {
+        uint64_t q = __atomic_load_n(&quantum_us, __ATOMIC_RELAXED);
+        st->deadline = AGT_cnt_cycles() + AGT_us_to_cycles(q);
+    }
+
+    program_timer(core);
+}
+
+
+void scheduler_timer_irq()
+{
+    size_t core = this_cpu_id();
+    sched_tick_t* st = cpu_tick(core);
+    uint64_t now = AGT_cnt_cycles();
+
+    while (st->sleepers && st->sleepers->wake_at <= now) {
+        thread* th = st->sleepers;
+
+        st->sleepers = th->timer_next;
+        th->timer_next = NULL;
+
+        enqueue(th, core);
+    }
+
+    if (st->deadline && st->deadline <= now) {
+        st->expired = st->deadline;
+        st->deadline = 0;
+        st->need_resched = true;
+        st->stats.ticks++;
+    }
+
+    // idle cores only program the sleepers
+    if (cpu_rq(core)->running)
+        tick_update(core, false);
+    else
+        program_timer(core);
+}
 
 
 static inline thread_node* node_from_thread(thread* th)
@@ -40,62 +168,611 @@ static inline thread_node* node_from_thread(thread* th)
 }
 
 
+/* --- Run queues --- */
+
+static void list_push_tail(rq_list* l, thread_node* n)
+{
+    n->next = NULL;
+    n->prev = l->tail;
+
+    if (l->tail)
+        l->tail->next = n;
+    else
+        l->head = n;
+
+    l->tail = n;
+}
+
+
+static void list_remove(rq_list* l, thread_node* n)
+{
+    if (n->prev)
+        n->prev->next = n->next;
+    else
+        l->head = n->next;
+
+    if (n->next)
+        n->next->prev = n->prev;
+    else
+        l->tail = n->prev;
+}
+
+
+static inline rq_list* rq_list_of(runqueue_t* q, uint8_t prio)
+{
+    return prio == SCHED_PRIO_BE ? &q->be : &q->rt[prio];
+}
+
+
+static void rq_push_tail(runqueue_t* q, thread_node* n)
+{
+    // set_prio can change th.prio while it is linked, the list is kept apart
+    const uint8_t prio = __atomic_load_n(&n->th.prio, __ATOMIC_RELAXED);
+
+    n->queued_prio = prio;
+    list_push_tail(rq_list_of(q, prio), n);
+
+    if (prio != SCHED_PRIO_BE)
+        q->rt_bitmap |= 1U << prio;
+
+    q->nr_ready++;
+}
+
+
+static void rq_remove(runqueue_t* q, thread_node* n)
+{
+    const uint8_t prio = n->queued_prio;
+    rq_list* l = rq_list_of(q, prio);
+
+    list_remove(l, n);
+
+    if (prio != SCHED_PRIO_BE && !l->head)
+        q->rt_bitmap &= ~(1U << prio);
+
+    q->nr_ready--;
+}
+
+
+/// highest ready priority of the queue, SCHED_PRIO_BE if no rt thread waits
+static inline uint8_t rq_top_prio(const runqueue_t* q)
+{
+    return q->rt_bitmap ? (uint8_t)(31 - __builtin_clz(q->rt_bitmap))
+                        : SCHED_PRIO_BE;
+}
+
+
+/// takes n off the queue for core, under the queue lock. Until set_running
+/// (or enqueue, if it has to leave) it is no longer READY, so rehome and
+/// set_prio do not look for it in a queue
+static void rq_pick(runqueue_t* q, thread_node* n, size_t core)
+{
+    rq_remove(q, n);
+
+    n->th.state = THREAD_PICKED;
+    n->th.cpu = (uint32_t)core;
+}
+
+
+/// O(1), the head of the highest non empty rt priority, else of the best
+/// effort fifo
+static thread_node* rq_pop_head(runqueue_t* q, size_t core)
+{
+    thread_node* n = q->rt_bitmap ? q->rt[rq_top_prio(q)].head : q->be.head;
+
+    if (n)
+        rq_pick(q, n, core);
+
+    return n;
+}
+
+
+/// true if th may not run in core, out of its affinity or asked to migrate
+static inline bool must_leave(const thread* th, size_t core)
+{
+    return !(th->affinity & (1U << core)) ||
+           (th->migrate_to && th->migrate_to - 1 != core);
+}
+
+
+/// Takes the thread nearest to the tail of the most urgent class, the one that
+/// would wait the most in the core and the coldest in its caches. The fp owner
+/// of the victim is skipped, its fp registers can only be resumed there, and so
+/// are the threads the stealer core may not run
+static thread_node* rq_steal(runqueue_t* q, size_t victim, size_t core)
+{
+    for (int p = SCHED_RT_PRIOS - 1; p >= 0; p--) {
+        rq_list* l = p == SCHED_PRIO_BE ? &q->be : &q->rt[p];
+
+        if (p != SCHED_PRIO_BE && !(q->rt_bitmap & (1U << p)))
+            continue;
+
+        for (thread_node* n = l->tail; n; n = n->prev) {
+            if (must_leave(&n->th, core) ||
+                fpu_live_core(&n->th) == (int64_t)victim)
+                continue;
+
+            rq_pick(q, n, core);
+            return n;
+        }
+    }
+
+    return NULL;
+}
+
+
+/// takes a ready thread from the core with the longest queue
+static thread_node* steal(size_t core)
+{
+    uint32_t tried = 1U << core;
+
+    for (;;) {
+        size_t victim = NUM_CORES;
+        size_t max = 0;
+
+        for (size_t i = 0; i < NUM_CORES; i++) {
+            size_t n = __atomic_load_n(&cpu_rq(i)->nr_ready, __ATOMIC_RELAXED);
+
+            if (!(tried & (1U << i)) && n > max) {
+                max = n;
+                victim = i;
+            }
+        }
+
+        if (victim == NUM_CORES)
+            return NULL;
+
+        thread_node* n;
+
+        irq_spinlocked(&cpu_rq(victim)->lock)
+        {
+            n = rq_steal(cpu_rq(victim), victim, core);
+        }
+
+        if (n)
+            return n;
+
+        // nothing this core may take there, or the victim ran them meanwhile
+        tried |= 1U << victim;
+    }
+}
+
+
+/// idle cores of the affinity of th first, then the shortest queue
+static size_t pick_core(const thread* th)
+{
+    size_t best = NUM_CORES;
+    size_t min = SIZE_MAX;
+
+    for (size_t i = 0; i < NUM_CORES; i++) {
+        if (!(th->affinity & (1U << i)))
+            continue;
+
+        if (__atomic_load_n(&cpu_rq(i)->idle, __ATOMIC_RELAXED))
+            return i;
+
+        size_t n = __atomic_load_n(&cpu_rq(i)->nr_ready, __ATOMIC_RELAXED);
+
+        if (n < min) {
+            min = n;
+            best = i;
+        }
+    }
+
+    DEBUG_ASSERT(best < NUM_CORES);
+    return best;
+}
+
+
+/// core where th should be queued: the one it was asked to migrate to, else
+/// the least loaded of its affinity
+static size_t dest_core(const thread* th)
+{
+    return th->migrate_to ? th->migrate_to - 1 : pick_core(th);
+}
+
+
+/// A thread with fp state live in a core is queued there even if it has to
+/// leave it, that core saves the state and forwards it when it pops it
+static size_t home_core(const thread* th)
+{
+    int64_t fp_core = fpu_live_core(th);
+
+    return fp_core >= 0 ? (size_t)fp_core : dest_core(th);
+}
+
+
+static inline uint64_t cycles_to_ns(uint64_t cycles)
+{
+    return (uint64_t)((__uint128_t)cycles * 1000000000ULL / AGT_cnt_freq());
+}
+
+
+static void enqueue(thread* th, size_t core)
+{
+    runqueue_t* q = cpu_rq(core);
+    bool kick;
+
+    th->ready_at = AGT_cnt_cycles();
+    th->acct.since = th->ready_at;
+
+    irq_spinlocked(&q->lock)
+    {
+        th->state = THREAD_READY;
+        th->cpu = (uint32_t)core;
+        rq_push_tail(q, node_from_thread(th));
+
+        // a rt thread preempts a less urgent running one without waiting for
+        // the end of its quantum
+        bool preempt = q->running && th->prio > q->running->prio;
+
+        if (preempt)
+            __atomic_store_n(
+                &cpu_tick(core)->need_resched,
+                true,
+                __ATOMIC_RELAXED);
+
+        // idle in wfi, running alone with the tick stopped, or preempted
+        kick = q->idle || preempt ||
+               (q->running && q->nr_ready == 1 &&
+                !__atomic_load_n(&cpu_tick(core)->deadline, __ATOMIC_RELAXED));
+    }
+
+    if (kick && core != this_cpu_id())
+        GICV3_send_sgi(
+            irq_id_new(SCHED_WAKE_SGI),
+            (ARM_cpu_affinity) {.aff3 = 0, .aff2 = 0, .aff1 = 0, .aff0 = core});
+}
+
+
+/// next thread for the core, from its queue or stolen from another one. The
+/// queued threads that may not run in the core are sent to their destination
+static thread_node* next_ready(size_t core)
+{
+    thread_node* n;
+
+    for (;;) {
+        irq_spinlocked(&cpu_rq(core)->lock)
+        {
+            n = rq_pop_head(cpu_rq(core), core);
+        }
+
+        if (!n || !must_leave(&n->th, core))
+            break;
+
+        fpu_release(&n->th);
+        enqueue(&n->th, dest_core(&n->th));
+    }
+
+    return n ? n : steal(core);
+}
+
+
+/// ends the run of th, the thread running in the core, at now
+static inline void acct_stop(thread* th, uint64_t now)
+{
+    th->acct.run += now - th->acct.since;
+    th->acct.since = now;
+}
+
+
+static void set_running(size_t core, thread_node* n)
+{
+    thread* th = &n->th;
+    thread* prev = cpu_rq(core)->running;
+    uint64_t now = AGT_cnt_cycles();
+
+    // a requeued thread picked again just goes on running
+    if (th != prev) {
+        th->acct.wait += now - th->acct.since;
+        th->acct.since = now;
+
+        if (th->acct.last_cpu != core) {
+            if (th->acct.last_cpu != UINT32_MAX) {
+                th->acct.nr_migrations++;
+                sched_trace(SCHED_TRACE_MIGRATE, th->th_uid, th->acct.last_cpu);
+            }
+
+            th->acct.last_cpu = (uint32_t)core;
+        }
+
+        sched_trace(SCHED_TRACE_SWITCH, prev ? prev->th_uid : 0, th->th_uid);
+    }
+
+    // wakeup to run latency of the rt class. A thread that was just requeued
+    // by its own core is not counted
+    if (th->prio != SCHED_PRIO_BE && th->ready_at) {
+        scheduler_stats* s = &cpu_tick(core)->stats;
+        uint64_t lat_ns = cycles_to_ns(now - th->ready_at);
+
+        s->rt_wakeups++;
+        s->rt_lat_sum_ns += lat_ns;
+
+        if (lat_ns > s->rt_lat_max_ns)
+            s->rt_lat_max_ns = lat_ns;
+    }
+
+    th->ready_at = 0;
+    th->state = THREAD_RUNNING;
+    th->cpu = (uint32_t)core;
+    th->migrate_to = 0;
+    cpu_rq(core)->running = th;
+
+    set_current_thread(th);
+}
+
+
+thread* scheduler_thread_new(utask* t, uint64_t pc, uint64_t sp, uint64_t arg)
+{
+    thread_node* n = kmalloc(sizeof(thread_node));
+    ASSERT(n, "scheduler_thread_new: could not allocate the thread");
+
+    static uint64_t next_th_uid = 1;
+
+    n->th = (thread) {
+        .th_uid = __atomic_fetch_add(&next_th_uid, 1, __ATOMIC_RELAXED),
+        .task.utask = t,
+        .sp = sp,
+        .pc = pc,
+        .ctx = {.x = {arg}, ._pad = 0},
+        .acct =
+            {
+                .run = 0,
+                .wait = 0,
+                .since = 0,
+                .nr_voluntary = 0,
+                .nr_involuntary = 0,
+                .nr_migrations = 0,
+                .last_cpu = UINT32_MAX,
+            },
+        .th_flags = 0,
+        .state = THREAD_NEW,
+        .cpu = 0,
+        .fp = {.fpcr = 0, .fpsr = 0, .v = {{0}}},
+        .wake_at = 0,
+        .timer_next = NULL,
+        .wq_next = NULL,
+        .wait_key = 0,
+        .prio = SCHED_PRIO_BE,
+        .base_prio = SCHED_PRIO_BE,
+        .ready_at = 0,
+        .affinity = SCHED_AFFINITY_ALL,
+        .migrate_to = 0,
+    };
+
+    thread* th = &n->th;
+
+    spinlocked(&t->lock)
+    {
+        kvec_push(&t->threads, &th);
+    }
+
+    size_t core = home_core(th);
+
+    sched_trace(SCHED_TRACE_WAKEUP, th->th_uid, core);
+    enqueue(th, core);
+
+    return th;
+}
+
+
+void scheduler_wake(thread* th)
+{
+    DEBUG_ASSERT(th->state == THREAD_SLEEPING || th->state == THREAD_NEW);
+
+    size_t core = home_core(th);
+
+    sched_trace(SCHED_TRACE_WAKEUP, th->th_uid, core);
+    enqueue(th, core);
+}
+
+
+/// the run of th ends before it can be woken, by another core too
+static inline void sleep_acct(thread* th)
+{
+    acct_stop(th, AGT_cnt_cycles());
+    th->acct.nr_voluntary++;
+}
+
+
+void scheduler_sleep_current()
+{
+    thread* th = saved_current_thread();
+
+    sleep_acct(th);
+    th->state = THREAD_SLEEPING;
+}
+
+
+void scheduler_sleep_until(uint64_t wake_at)
+{
+    sched_tick_t* st = cpu_tick(this_cpu_id());
+    thread* th = saved_current_thread();
+
+    sleep_acct(th);
+    th->state = THREAD_SLEEPING;
+    th->wake_at = wake_at;
+
+    thread** link = &st->sleepers;
+    while (*link && (*link)->wake_at <= wake_at)
+        link = &(*link)->timer_next;
+
+    th->timer_next = *link;
+    *link = th;
+
+    program_timer(this_cpu_id());
+}
+
+
 static void scheduler_init()
 {
     asm volatile("msr sp_el0, xzr");
 
     for (size_t i = 0; i < NUM_CORES; i++) {
-        scheduler[i].list = NULL;
-        local_el1_ctx[i][0] = 0;
-        local_el1_ctx[i][1] = 0;
+        *cpu_rq(i) = (runqueue_t) {
+            .lock = SPINLOCK_INIT,
+            .be = {NULL, NULL},
+            .rt = {{NULL, NULL}},
+            .rt_bitmap = 0,
+            .nr_ready = 0,
+            .running = NULL,
+            .idle = false,
+        };
+
+        (*per_cpu_ptr(el1_ctx, i))[0] = 0;
+        (*per_cpu_ptr(el1_ctx, i))[1] = 0;
+
+        *cpu_tick(i) = (sched_tick_t) {
+            .deadline = 0,
+            .expired = 0,
+            .need_resched = false,
+            .sleepers = NULL,
+            .stats =
+                {
+                    .ticks = 0,
+                    .preemptions = 0,
+                    .lat_min_ns = UINT64_MAX,
+                    .lat_max_ns = 0,
+                    .lat_sum_ns = 0,
+                    .rt_wakeups = 0,
+                    .rt_lat_max_ns = 0,
+                    .rt_lat_sum_ns = 0,
+                },
+        };
     }
 }
 
+
+// before the stage 2 initcalls, which can already create threads
+KERNEL_INITCALL(scheduler_init, KERNEL_INITCALL_STAGE1);
+
+
 void scheduler_loop_cpu_enter()
 {
-    static bool sched_init = false;
+    size_t core = this_cpu_id();
 
-    __attribute((unused)) uint64_t i;
+    GICV3_enable_ppi(
+        &GIC_DRIVER,
+        irq_id_new(SCHED_WAKE_SGI),
+        ARM_get_cpu_affinity());
 
-    if (!sched_init) {
-        scheduler_init();
-        sched_init = true;
-    }
+    // marked before looking at the queues, so an enqueue that races with
+    // this check still sends the sgi that ends the wfi of the caller
+    __atomic_store_n(&cpu_rq(core)->idle, true, __ATOMIC_SEQ_CST);
 
-    uint64_t cpuid = get_cpuid();
+    thread_node* n = next_ready(core);
 
-    thread_node* list = scheduler[cpuid].list;
-
-    if (!list)
+    if (!n)
         return;
 
-    thread* th = &list->th;
+    __atomic_store_n(&cpu_rq(core)->idle, false, __ATOMIC_RELAXED);
 
+    thread* th = &n->th;
 
-    set_current_thread(th);
+    set_running(core, n);
     save_current_thread();
+    fpu_switch_to(th);
+
+    GICV3_enable_ppi(
+        &GIC_DRIVER,
+        irq_id_new(SCHED_TICK_PPI),
+        ARM_get_cpu_affinity());
+    tick_update(core, true);
 
     _scheduler_loop_cpu_enter(
         &th->ctx,
         th->sp,
         th->pc,
-        &local_el1_ctx[cpuid][0]);
+        *per_cpu_ptr(el1_ctx, core));
 }
 
 
 void scheduler_loop_cpu_exit()
 {
-    _scheduler_loop_cpu_exit(&local_el1_ctx[get_cpuid()][0]);
+    size_t core = this_cpu_id();
+
+    // idle, the comparator is left only for the timed sleepers
+    cpu_rq(core)->running = NULL;
+    cpu_tick(core)->deadline = 0;
+    program_timer(core);
+
+    // only a core that went through scheduler_loop_cpu_enter has a frame of
+    // the idle loop to return to
+    DEBUG_ASSERT((*per_cpu_ptr(el1_ctx, core))[2] != 0);
+
+    _scheduler_loop_cpu_exit(*per_cpu_ptr(el1_ctx, core));
 }
 
 
+/// requeues the current thread if it is still runnable and returns the next
+/// one, NULL if the core has nothing to run
 static thread* schedule()
 {
-    thread* th = get_current_thread();
-    thread_node* node = node_from_thread(th);
+    size_t core = this_cpu_id();
+    runqueue_t* q = cpu_rq(core);
+    thread* prev = get_current_thread();
+    bool runnable = false;
+    bool leave = false;
+
+    // a pending preemption is served by this switch
+    __atomic_store_n(&cpu_tick(core)->need_resched, false, __ATOMIC_RELAXED);
+
+    irq_spinlocked(&q->lock)
+    {
+        // a sleeping prev woken by another core before this switch is already
+        // queued, or even running elsewhere
+        if (prev->state == THREAD_RUNNING && prev->cpu == core) {
+            // before it is queued, another core can take it right after
+            acct_stop(prev, AGT_cnt_cycles());
+
+            runnable = true;
+            leave = must_leave(prev, core);
+
+            if (!leave) {
+                prev->state = THREAD_READY;
+                prev->ready_at = 0;
+                rq_push_tail(q, node_from_thread(prev));
+            }
+        }
+    }
+
+    if (leave) {
+        fpu_release(prev);
+        enqueue(prev, dest_core(prev));
+    }
+
+    thread_node* n = next_ready(core);
+
+    if (runnable && (!n || &n->th != prev))
+        __atomic_fetch_add(&prev->acct.nr_involuntary, 1, __ATOMIC_RELAXED);
+
+    if (!n)
+        return NULL;
+
+    set_running(core, n);
+    tick_update(core, true);
+
+    return &n->th;
+}
+
+
+thread* scheduler_current_thread()
+{
+    return saved_current_thread();
+}
+
+
+utask* scheduler_current_utask()
+{
+    return saved_current_thread()->task.utask;
+}
+
+
+bool scheduler_local_has_ready()
+{
+    size_t core = this_cpu_id();
 
-    set_current_thread(&node->next->th);
-    return &node->next->th;
+    return __atomic_load_n(&cpu_rq(core)->nr_ready, __ATOMIC_RELAXED) != 0 ||
+           __atomic_load_n(&cpu_tick(core)->need_resched, __ATOMIC_RELAXED);
 }
 
 
@@ -110,6 +787,20 @@ void scheduler_ectx_save(arm_exception_ctx* ectx)
 }
 
 
+/// loads cur (which must be in sp_el0) as the el0 context to return to
+static void resume_thread(thread* cur, arm_exception_ctx* ectx)
+{
+    // saved before sp_el0 is overwritten with the user stack
+    save_current_thread();
+    fpu_switch_to(cur);
+
+    *ectx = cur->ctx;
+
+    asm volatile("msr elr_el1, %0" : : "r"(cur->pc) : "memory");
+    asm volatile("msr sp_el0, %0" : : "r"(cur->sp) : "memory");
+}
+
+
 void schedurer_ectx_restore(arm_exception_ctx* ectx)
 {
     thread* cur = schedule();
@@ -117,10 +808,249 @@ void schedurer_ectx_restore(arm_exception_ctx* ectx)
     if (!cur)
         return scheduler_loop_cpu_exit();
 
-    *ectx = cur->ctx;
+    resume_thread(cur, ectx);
+}
 
-    asm volatile("msr sp_el0, %0" : : "r"(cur->pc) : "memory");
-    asm volatile("msr sp_el0, %0" : : "r"(cur->sp) : "memory");
 
-    save_current_thread();
+void scheduler_irq_enter(arm_exception_ctx* ectx)
+{
+    scheduler_ectx_save(ectx);
+}
+
+
+void scheduler_irq_exit(arm_exception_ctx* ectx)
+{
+    sched_tick_t* st = cpu_tick(this_cpu_id());
+
+    if (!st->need_resched) {
+        // a thread queued meanwhile could need the stopped tick
+        tick_update(this_cpu_id(), false);
+        return resume_thread(get_current_thread(), ectx);
+    }
+
+    st->need_resched = false;
+
+    schedurer_ectx_restore(ectx);
+
+    // preempted by a rt wakeup, not by the end of the quantum
+    if (!st->expired)
+        return;
+
+    uint64_t lat_ns = cycles_to_ns(AGT_cnt_cycles() - st->expired);
+    st->expired = 0;
+
+    st->stats.preemptions++;
+    st->stats.lat_sum_ns += lat_ns;
+
+    if (lat_ns < st->stats.lat_min_ns)
+        st->stats.lat_min_ns = lat_ns;
+    if (lat_ns > st->stats.lat_max_ns)
+        st->stats.lat_max_ns = lat_ns;
+}
+
+
+/// moves th to the list of its priority if it is linked in the queue of core
+/// with another one. Returns false if th left core before the lock was taken
+static bool requeue_prio(thread* th, size_t core)
+{
+    runqueue_t* q = cpu_rq(core);
+    bool stable = false;
+
+    irq_spinlocked(&q->lock)
+    {
+        // only the owner of the queue lock moves a READY thread out of it
+        if (th->cpu == core) {
+            thread_node* n = node_from_thread(th);
+
+            if (th->state == THREAD_READY && n->queued_prio != th->prio) {
+                rq_remove(q, n);
+                rq_push_tail(q, n);
+            }
+
+            stable = true;
+        }
+    }
+
+    return stable;
+}
+
+
+/// changes the effective priority of th, moving it between the queues of its
+/// core if it is ready. A thread queued meanwhile takes the new priority, or is
+/// moved by requeue_prio, the lists never see a priority they were not linked
+/// with
+static void set_prio(thread* th, uint8_t prio)
+{
+    ASSERT(prio < SCHED_RT_PRIOS);
+
+    __atomic_store_n(&th->prio, prio, __ATOMIC_RELAXED);
+
+    while (!requeue_prio(th, __atomic_load_n(&th->cpu, __ATOMIC_RELAXED)))
+        ;
+}
+
+
+void scheduler_set_priority(thread* th, uint8_t prio)
+{
+    // an inherited priority is kept until scheduler_pi_restore
+    bool boosted = th->prio > th->base_prio;
+
+    th->base_prio = prio;
+
+    if (!boosted || prio > th->prio)
+        set_prio(th, prio);
+}
+
+
+void scheduler_pi_boost(thread* owner, uint8_t prio)
+{
+    if (prio > owner->prio)
+        set_prio(owner, prio);
+}
+
+
+void scheduler_pi_restore(thread* owner)
+{
+    if (owner->prio != owner->base_prio)
+        set_prio(owner, owner->base_prio);
+}
+
+
+/// Moves th out of a core it must leave. A ready thread is requeued right away
+/// unless its fp state is live there, then that core (as for a running one or
+/// one it just picked) is asked to reschedule and forwards it itself
+static void rehome(thread* th)
+{
+    size_t core = __atomic_load_n(&th->cpu, __ATOMIC_RELAXED);
+    runqueue_t* q = cpu_rq(core);
+    bool move = false;
+    bool resched = false;
+
+    irq_spinlocked(&q->lock)
+    {
+        // a sleeping thread goes to a valid core when it is woken
+        if (th->cpu == core && must_leave(th, core)) {
+            if (th->state == THREAD_READY &&
+                fpu_live_core(th) != (int64_t)core) {
+                // not READY until enqueue links it in the new core
+                rq_pick(q, node_from_thread(th), core);
+                move = true;
+            }
+            else if (th->state == THREAD_READY ||
+                     th->state == THREAD_PICKED ||
+                     th->state == THREAD_RUNNING)
+                resched = true;
+        }
+    }
+
+    if (move)
+        enqueue(th, dest_core(th));
+
+    if (!resched)
+        return;
+
+    __atomic_store_n(&cpu_tick(core)->need_resched, true, __ATOMIC_RELAXED);
+
+    if (core != this_cpu_id())
+        GICV3_send_sgi(
+            irq_id_new(SCHED_WAKE_SGI),
+            (ARM_cpu_affinity) {.aff3 = 0, .aff2 = 0, .aff1 = 0, .aff0 = core});
+}
+
+
+void scheduler_set_affinity(thread* th, uint32_t mask)
+{
+    mask &= SCHED_AFFINITY_ALL;
+    ASSERT(mask, "scheduler_set_affinity: empty affinity mask");
+
+    uint32_t to = __atomic_load_n(&th->migrate_to, __ATOMIC_RELAXED);
+
+    // a pending migration out of the new mask is dropped
+    if (to && !(mask & (1U << (to - 1))))
+        __atomic_store_n(&th->migrate_to, 0, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&th->affinity, mask, __ATOMIC_RELAXED);
+
+    rehome(th);
+}
+
+
+void thread_migrate(thread* th, size_t core)
+{
+    ASSERT(core < NUM_CORES);
+    ASSERT(
+        th->affinity & (1U << core),
+        "thread_migrate: core out of the affinity of the thread");
+
+    __atomic_store_n(&th->migrate_to, (uint32_t)(core + 1), __ATOMIC_RELAXED);
+
+    rehome(th);
+}
+
+
+void scheduler_set_quantum_us(uint64_t us)
+{
+    ASSERT(us > 0);
+    __atomic_store_n(&quantum_us, us, __ATOMIC_RELAXED);
+}
+
+
+scheduler_stats scheduler_get_stats(size_t core)
+{
+    ASSERT(core < NUM_CORES);
+    return cpu_tick(core)->stats;
+}
+
+
+void scheduler_print_stats()
+{
+    // fmt only prints 32 bit integers
+    for (size_t i = 0; i < NUM_CORES; i++) {
+        scheduler_stats s = cpu_tick(i)->stats;
+
+        kprintf(
+            "[sched] core %u: ticks %u preempt %u lat max %uns avg %uns\n\r",
+            (uint32_t)i,
+            (uint32_t)s.ticks,
+            (uint32_t)s.preemptions,
+            (uint32_t)s.lat_max_ns,
+            (uint32_t)(s.preemptions ? s.lat_sum_ns / s.preemptions : 0));
+        kprintf(
+            "[sched] core %u: rt wakeups %u lat max %uns avg %uns\n\r",
+            (uint32_t)i,
+            (uint32_t)s.rt_wakeups,
+            (uint32_t)s.rt_lat_max_ns,
+            (uint32_t)(s.rt_wakeups ? s.rt_lat_sum_ns / s.rt_wakeups : 0));
+    }
+}
+
+
+void scheduler_print_task(utask* t)
+{
+    uint64_t freq = AGT_cnt_freq();
+
+    spinlocked(&t->lock)
+    {
+        for (size_t i = 0; i < kvec_len(t->threads); i++) {
+            thread* th;
+            kvec_get_copy(&t->threads, i, &th);
+
+            thread_acct a = th->acct;
+
+            kprintf(
+                "[sched] %s thread %u: run %uus wait %uus\n\r",
+                t->task_name,
+                (uint32_t)th->th_uid,
+                (uint32_t)((__uint128_t)a.run * 1000000 / freq),
+                (uint32_t)((__uint128_t)a.wait * 1000000 / freq));
+            kprintf(
+                "[sched] %s thread %u: voluntary %u involuntary %u "
+                "migrations %u\n\r",
+                t->task_name,
+                (uint32_t)th->th_uid,
+                a.nr_voluntary,
+                a.nr_involuntary,
+                a.nr_migrations);
+        }
+    }
 }
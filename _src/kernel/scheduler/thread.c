@@ -1,21 +1,17 @@
 #include "thread.h"
 
-#include <kernel/hardware.h>
+#include <kernel/percpu.h>
 #include <kernel/scheduler.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#include "kernel/lib/smp.h"
 #include "kernel/mm.h"
 #include "kernel/panic.h"
 
 
-typedef struct {
-    _Alignas(CACHE_LINE) thread* th;
-} local_th;
-
-
-static local_th local_threads[NUM_CORES];
+// sp_el0 holds the user stack pointer at el0 exception entry, so the current
+// thread is kept here too
+static DEFINE_PER_CPU(thread*, saved_th);
 
 static inline uint64_t get_sp_el0(void)
 {
@@ -29,7 +25,16 @@ void save_current_thread()
     thread* cur = get_current_thread();
     DEBUG_ASSERT(cur && ((uintptr_t)cur & KERNEL_BASE) == KERNEL_BASE);
 
-    local_threads[get_cpuid()].th = cur;
+    this_cpu_write(saved_th, cur);
+}
+
+
+thread* saved_current_thread()
+{
+    thread* cur = this_cpu_read(saved_th);
+    DEBUG_ASSERT(cur && ((uintptr_t)cur & KERNEL_BASE) == KERNEL_BASE);
+
+    return cur;
 }
 
 
@@ -38,7 +43,7 @@ thread* restore_current_thread(uint64_t* old_sp0)
     if (old_sp0)
         *old_sp0 = get_sp_el0();
 
-    thread* cur = local_threads[get_cpuid()].th;
+    thread* cur = this_cpu_read(saved_th);
     DEBUG_ASSERT(cur && ((uintptr_t)cur & KERNEL_BASE) == KERNEL_BASE);
 
     set_current_thread(cur);
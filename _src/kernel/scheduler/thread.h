@@ -25,3 +25,7 @@ static inline void set_current_thread(thread* th)
 
 void save_current_thread();
 thread* restore_current_thread(uint64_t* old_sp0);
+
+/// returns the thread saved by save_current_thread without touching sp_el0,
+/// which holds the user stack pointer while handling an el0 exception
+thread* saved_current_thread();
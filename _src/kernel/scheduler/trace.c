@@ -0,0 +1,77 @@
+#include <drivers/arm_generic_timer/arm_generic_timer.h>
+#include <kernel/hardware.h>
+#include <kernel/percpu.h>
+#include <kernel/sched_trace.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/io/stdio.h"
+
+_Static_assert(
+    (SCHED_TRACE_LEN & (SCHED_TRACE_LEN - 1)) == 0,
+    "SCHED_TRACE_LEN must be a power of 2");
+
+
+typedef struct {
+    // events recorded by the core, the ring keeps the last SCHED_TRACE_LEN
+    _Alignas(CACHE_LINE) uint64_t head;
+    sched_trace_entry ring[SCHED_TRACE_LEN];
+} trace_ring_t;
+
+static DEFINE_PER_CPU(trace_ring_t, trace);
+
+static const char* const EVENT_NAME[] = {
+    [SCHED_TRACE_SWITCH] = "switch",
+    [SCHED_TRACE_WAKEUP] = "wakeup",
+    [SCHED_TRACE_MIGRATE] = "migrate",
+};
+
+
+void sched_trace(sched_trace_event event, uint64_t th, uint64_t arg)
+{
+    trace_ring_t* r = this_cpu_ptr(trace);
+    uint64_t head = r->head;
+
+    r->ring[head & (SCHED_TRACE_LEN - 1)] = (sched_trace_entry) {
+        .ts = AGT_cnt_cycles(),
+        .th = th,
+        .arg = arg,
+        .event = event,
+        ._pad = 0,
+    };
+
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+void sched_trace_dump(io_out io)
+{
+    uint64_t freq = AGT_cnt_freq();
+
+    for (size_t i = 0; i < NUM_CORES; i++) {
+        trace_ring_t* r = per_cpu_ptr(trace, i);
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > SCHED_TRACE_LEN ? head - SCHED_TRACE_LEN : 0;
+
+        // fmt only prints 32 bit integers
+        fkprintf(
+            io,
+            "[trace] core %u: %u events\n\r",
+            (uint32_t)i,
+            (uint32_t)head);
+
+        for (uint64_t n = first; n < head; n++) {
+            sched_trace_entry e = r->ring[n & (SCHED_TRACE_LEN - 1)];
+            uint64_t us = (uint64_t)((__uint128_t)e.ts * 1000000 / freq);
+
+            fkprintf(
+                io,
+                "[trace] %uus core %u %s %u %u\n\r",
+                (uint32_t)us,
+                (uint32_t)i,
+                EVENT_NAME[e.event],
+                (uint32_t)e.th,
+                (uint32_t)e.arg);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#include <arm/mmu.h>
+#include <kernel/mm.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <kernel/vtime.h>
+#include <lib/lock/spinlock.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/lib/kvec.h"
+#include "kernel/panic.h"
+
+
+static uint64_t next_task_uid = 1;
+
+
+utask* utask_new(const char* name)
+{
+    utask* t = kmalloc(sizeof(utask));
+    ASSERT(t, "utask_new: could not allocate the task");
+
+    *t = (utask) {
+        .task_uid = __atomic_fetch_add(&next_task_uid, 1, __ATOMIC_RELAXED),
+        .task_name = name,
+        .lock = (spinlock_t)SPINLOCK_INIT,
+        .mapping = mm_mmu_mapping_new(MMU_LO),
+        .regions = NULL,
+        .threads = kvec_new(thread*),
+        .map_next = UTASK_MAP_BASE,
+        .ring = NULL,
+        .zc_writes = 0,
+    };
+
+    vtime_map(t);
+
+    return t;
+}
+
+
+utask* utask_clone(utask* src, const char* name)
+{
+    utask* t = kmalloc(sizeof(utask));
+    ASSERT(t, "utask_clone: could not allocate the task");
+
+    *t = (utask) {
+        .task_uid = __atomic_fetch_add(&next_task_uid, 1, __ATOMIC_RELAXED),
+        .task_name = name,
+        .lock = (spinlock_t)SPINLOCK_INIT,
+        .mapping = mm_mmu_mapping_new(MMU_LO),
+        .regions = NULL,
+        .threads = kvec_new(thread*),
+        .map_next = src->map_next,
+        .ring = NULL, // the region is cloned, but it is not a ring of t
+        .zc_writes = 0,
+    };
+
+    // src must not map or unmap regions while its pages are being shared
+    spin_lock(&src->lock);
+    umalloc_clone_cow(t, src);
+    spin_unlock(&src->lock);
+
+    // not a region, so not cloned with them
+    vtime_map(t);
+
+    return t;
+}
@@ -0,0 +1,117 @@
+#include <kernel/scheduler.h>
+#include <kernel/waitqueue.h>
+#include <lib/lock/spinlock.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/panic.h"
+
+
+void wait_queue_sleep_locked(wait_queue* wq, uintptr_t key)
+{
+    thread* th = scheduler_current_thread();
+
+    th->wait_key = key;
+    th->wq_next = NULL;
+
+    if (wq->tail)
+        wq->tail->wq_next = th;
+    else
+        wq->head = th;
+
+    wq->tail = th;
+
+    scheduler_sleep_current();
+}
+
+
+size_t wait_queue_wake(wait_queue* wq, uintptr_t key, size_t n)
+{
+    size_t woken = 0;
+    thread* wake_head = NULL;
+    thread** wake_tail = &wake_head;
+
+    spinlocked(&wq->lock)
+    {
+        thread* prev = NULL;
+        thread* cur = wq->head;
+
+        while (cur && woken < n) {
+            thread* next = cur->wq_next;
+
+            if (cur->wait_key != key) {
+                prev = cur;
+                cur = next;
+                continue;
+            }
+
+            if (prev)
+                prev->wq_next = next;
+            else
+                wq->head = next;
+
+            if (wq->tail == cur)
+                wq->tail = prev;
+
+            cur->wq_next = NULL;
+            *wake_tail = cur;
+            wake_tail = &cur->wq_next;
+            woken++;
+
+            cur = next;
+        }
+    }
+
+    // queued out of the wait queue lock, as enqueue takes the run queue one
+    while (wake_head) {
+        thread* th = wake_head;
+        wake_head = th->wq_next;
+
+        th->wq_next = NULL;
+        scheduler_wake(th);
+    }
+
+    return woken;
+}
+
+
+struct thread* wait_queue_pop_locked(wait_queue* wq, uintptr_t key)
+{
+    thread* best = NULL;
+    thread* best_prev = NULL;
+    thread* prev = NULL;
+
+    for (thread* cur = wq->head; cur; prev = cur, cur = cur->wq_next) {
+        if (cur->wait_key == key && (!best || cur->prio > best->prio)) {
+            best = cur;
+            best_prev = prev;
+        }
+    }
+
+    if (!best)
+        return NULL;
+
+    if (best_prev)
+        best_prev->wq_next = best->wq_next;
+    else
+        wq->head = best->wq_next;
+
+    if (wq->tail == best)
+        wq->tail = best_prev;
+
+    best->wq_next = NULL;
+
+    return best;
+}
+
+
+int32_t wait_queue_top_prio_locked(const wait_queue* wq, uintptr_t key)
+{
+    int32_t top = -1;
+
+    for (const thread* cur = wq->head; cur; cur = cur->wq_next)
+        if (cur->wait_key == key && (int32_t)cur->prio > top)
+            top = cur->prio;
+
+    return top;
+}
@@ -0,0 +1,310 @@
+#include <arm/mmu.h>
+#include <kernel/hardware.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/waitqueue.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ *  The futexes are private to a task: the key is the user va of the word (48
+ *  bits at most) tagged with the uid of the task in the upper bits.
+ *
+ *  The pi futexes hold the tid of their owner. Userspace takes and releases
+ *  them with a cas while they are not contended, a waiter marks them with
+ *  SYSC_FUTEX_WAITERS and boosts the owner, which then has to unlock them
+ *  through the kernel, that hands the word to the most urgent waiter
+ */
+
+#define FUTEX_BUCKETS 64
+
+typedef struct {
+    _Alignas(CACHE_LINE) wait_queue wq;
+} futex_bucket;
+
+static futex_bucket buckets[FUTEX_BUCKETS] = {
+    [0 ... FUTEX_BUCKETS - 1] = {.wq = WAIT_QUEUE_INIT},
+};
+
+
+static inline uintptr_t futex_key(const utask* t, uintptr_t uaddr)
+{
+    return uaddr ^ ((uintptr_t)t->task_uid << 48);
+}
+
+
+static inline wait_queue* futex_wq(uintptr_t key)
+{
+    uintptr_t h = (key >> 2) * 0x9E3779B97F4A7C15ULL;
+
+    return &buckets[(h >> 58) % FUTEX_BUCKETS].wq;
+}
+
+
+/// the u32 at uaddr through the user va of the active task mapping, or
+/// SYSC_FUTEX_FAULT if it was unmapped since it was checked. Read under
+/// t->lock, so a munmap can not free the page in between
+static int64_t futex_read(utask* t, uintptr_t uaddr)
+{
+    int64_t v = SYSC_FUTEX_FAULT;
+
+    spinlocked(&t->lock)
+    {
+        if (mmu_translate(&t->mapping, uaddr).mapped)
+            v = *(volatile uint32_t*)uaddr;
+    }
+
+    return v;
+}
+
+
+int64_t sysc_futex_wait(const uint64_t args[6])
+{
+    const uintptr_t uaddr = args[0];
+    const uint32_t val = (uint32_t)args[1];
+
+    thread* th = scheduler_current_thread();
+    utask* t = th->task.utask;
+
+    // a lazy page is assigned, as a read of the task would do
+    if (uaddr % sizeof(uint32_t) != 0 ||
+        !umalloc_user_readable(t, uaddr, sizeof(uint32_t)))
+        return SYSC_FUTEX_FAULT;
+
+    const uintptr_t key = futex_key(t, uaddr);
+    wait_queue* wq = futex_wq(key);
+    int64_t result = SYSC_RESULT_STORED;
+
+    spinlocked(&wq->lock)
+    {
+        // checked under the bucket lock, a wake after the change of the value
+        // can not be lost
+        const int64_t cur = futex_read(t, uaddr);
+
+        if (cur < 0)
+            result = SYSC_FUTEX_FAULT;
+        else if ((uint32_t)cur != val)
+            result = SYSC_FUTEX_AGAIN;
+        else {
+            // stored before the thread is visible to the wakers
+            th->ctx.x[0] = (uint64_t)SYSC_FUTEX_OK;
+            wait_queue_sleep_locked(wq, key);
+        }
+    }
+
+    return result;
+}
+
+
+int64_t sysc_futex_wake(const uint64_t args[6])
+{
+    const uintptr_t uaddr = args[0];
+    const size_t n = args[1];
+
+    utask* t = scheduler_current_utask();
+
+    if (uaddr % sizeof(uint32_t) != 0)
+        return SYSC_FUTEX_FAULT;
+
+    const uintptr_t key = futex_key(t, uaddr);
+
+    return (int64_t)wait_queue_wake(futex_wq(key), key, n);
+}
+
+
+static inline uint32_t futex_tid(const thread* th)
+{
+    return (uint32_t)th->th_uid & SYSC_FUTEX_TID_MASK;
+}
+
+
+/// thread of t whose futex tid is tid, NULL if there is none
+static thread* task_thread(utask* t, uint32_t tid)
+{
+    thread* found = NULL;
+
+    spinlocked(&t->lock)
+    {
+        for (size_t i = 0; i < kvec_len(t->threads) && !found; i++) {
+            thread* th;
+            kvec_get_copy(&t->threads, i, &th);
+
+            if (futex_tid(th) == tid)
+                found = th;
+        }
+    }
+
+    return found;
+}
+
+
+/// the kernel writes the pi words through the user va: a lazy page is assigned
+/// and a cow one copied first, as a write of the task would do
+static bool futex_word_writable(utask* t, uintptr_t uaddr)
+{
+    mmu_translation tr = mmu_translate(&t->mapping, uaddr);
+
+    if (!tr.mapped && umalloc_handle_translation_fault(t, uaddr, true, false))
+        tr = mmu_translate(&t->mapping, uaddr);
+
+    if (tr.mapped && tr.cfg.ap != MMU_AP_EL0_RW_EL1_RW &&
+        umalloc_handle_write_fault(t, uaddr))
+        tr = mmu_translate(&t->mapping, uaddr);
+
+    return tr.mapped && tr.cfg.ap == MMU_AP_EL0_RW_EL1_RW;
+}
+
+
+/// takes the word for th or sleeps on it boosting its owner. The bucket lock
+/// of key held
+static int64_t lock_pi_locked(
+    thread* th,
+    volatile uint32_t* w,
+    wait_queue* wq,
+    uintptr_t key)
+{
+    const uint32_t tid = futex_tid(th);
+    uint32_t v = __atomic_load_n(w, __ATOMIC_RELAXED);
+
+    for (;;) {
+        const uint32_t owner_tid = v & SYSC_FUTEX_TID_MASK;
+
+        if (owner_tid == 0) {
+            // released by a cas of the owner while waiters were being added
+            if (__atomic_compare_exchange_n(
+                    w,
+                    &v,
+                    tid | (v & SYSC_FUTEX_WAITERS),
+                    false,
+                    __ATOMIC_ACQUIRE,
+                    __ATOMIC_RELAXED))
+                return SYSC_FUTEX_OK;
+
+            continue;
+        }
+
+        // already owned by th, or by a thread that does not exist
+        thread* owner = owner_tid == tid
+                            ? NULL
+                            : task_thread(th->task.utask, owner_tid);
+
+        if (!owner)
+            return SYSC_ERR_INVAL;
+
+        // the owner can not leave userspace unlocking it with a cas anymore
+        if (!__atomic_compare_exchange_n(
+                w,
+                &v,
+                v | SYSC_FUTEX_WAITERS,
+                false,
+                __ATOMIC_RELAXED,
+                __ATOMIC_RELAXED))
+            continue;
+
+        scheduler_pi_boost(owner, th->prio);
+
+        // the unlocker hands the word to th before waking it
+        th->ctx.x[0] = (uint64_t)SYSC_FUTEX_OK;
+        wait_queue_sleep_locked(wq, key);
+
+        return SYSC_RESULT_STORED;
+    }
+}
+
+
+int64_t sysc_futex_lock_pi(const uint64_t args[6])
+{
+    const uintptr_t uaddr = args[0];
+
+    thread* th = scheduler_current_thread();
+    utask* t = th->task.utask;
+
+    if (uaddr % sizeof(uint32_t) != 0 || !futex_word_writable(t, uaddr))
+        return SYSC_FUTEX_FAULT;
+
+    const uintptr_t key = futex_key(t, uaddr);
+    wait_queue* wq = futex_wq(key);
+    int64_t result;
+
+    spinlocked(&wq->lock)
+    {
+        result = lock_pi_locked(th, (volatile uint32_t*)uaddr, wq, key);
+    }
+
+    return result;
+}
+
+
+/// hands the word of th to its most urgent waiter, returned in next to be
+/// woken. The bucket lock of key held
+static int64_t unlock_pi_locked(
+    thread* th,
+    volatile uint32_t* w,
+    wait_queue* wq,
+    uintptr_t key,
+    thread** next)
+{
+    const uint32_t v = __atomic_load_n(w, __ATOMIC_RELAXED);
+
+    if ((v & SYSC_FUTEX_TID_MASK) != futex_tid(th))
+        return SYSC_ERR_INVAL;
+
+    thread* n = wait_queue_pop_locked(wq, key);
+
+    if (!n) {
+        __atomic_store_n(w, 0, __ATOMIC_RELEASE);
+        return SYSC_FUTEX_OK;
+    }
+
+    // the new owner inherits from the waiters left
+    const int32_t top = wait_queue_top_prio_locked(wq, key);
+
+    __atomic_store_n(
+        w,
+        futex_tid(n) | (top >= 0 ? SYSC_FUTEX_WAITERS : 0),
+        __ATOMIC_RELEASE);
+
+    if (top >= 0)
+        scheduler_pi_boost(n, (uint8_t)top);
+
+    *next = n;
+
+    return SYSC_FUTEX_OK;
+}
+
+
+int64_t sysc_futex_unlock_pi(const uint64_t args[6])
+{
+    const uintptr_t uaddr = args[0];
+
+    thread* th = scheduler_current_thread();
+    utask* t = th->task.utask;
+
+    if (uaddr % sizeof(uint32_t) != 0 || !futex_word_writable(t, uaddr))
+        return SYSC_FUTEX_FAULT;
+
+    const uintptr_t key = futex_key(t, uaddr);
+    wait_queue* wq = futex_wq(key);
+    thread* next = NULL;
+    int64_t result;
+
+    spinlocked(&wq->lock)
+    {
+        result =
+            unlock_pi_locked(th, (volatile uint32_t*)uaddr, wq, key, &next);
+    }
+
+    if (result != SYSC_FUTEX_OK)
+        return result;
+
+    // preempted by a more urgent ready thread at the scheduling point after
+    // the call
+    scheduler_pi_restore(th);
+
+    if (next)
+        scheduler_wake(next);
+
+    return SYSC_FUTEX_OK;
+}
@@ -0,0 +1,137 @@
+#include <drivers/uart/uart.h>
+#include <kernel/devices/drivers.h>
+#include <kernel/mm.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/waitqueue.h>
+#include <lib/lock/spinlock.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/io/stdio.h"
+#include "lib/align.h"
+
+// below it, copying to the tx buffer is cheaper than sleeping until the send
+#define WRITE_ZC_MIN 256
+// segments of a zero copy write, a more fragmented buffer is copied
+#define WRITE_MAX_SEGS 16
+
+
+// writers sleeping until the uart sent their buffer, keyed by thread
+static wait_queue write_wq = WAIT_QUEUE_INIT;
+
+
+int64_t sysc_print(const uint64_t args[6])
+{
+    const uintptr_t buf = args[0];
+    const size_t size = args[1];
+
+    // the task mapping is the active one, buf is read through its user va
+    if (!umalloc_user_readable(scheduler_current_utask(), buf, size))
+        return SYSC_ERR_FAULT;
+
+    fkwrite(IO_STDOUT, (const char*)buf, size);
+
+    return 0;
+}
+
+
+/// splits [buf, buf + size) in the segments of its kernel va, merging the
+/// contiguous pages. Returns how many, 0 if it can not be sent without a copy
+static size_t write_segments(
+    utask* t,
+    uintptr_t buf,
+    size_t size,
+    uart_sg segs[WRITE_MAX_SEGS])
+{
+    const uintptr_t end = buf + size;
+    size_t n = 0;
+
+    for (uintptr_t va = buf; va < end;) {
+        size_t len = align_down(va + KPAGE_SIZE, KPAGE_SIZE) - va;
+        if (len > end - va)
+            len = end - va;
+
+        const uint8_t* kva = umalloc_user_kva(t, va);
+        if (!kva)
+            return 0;
+
+        if (n > 0 && segs[n - 1].buf + segs[n - 1].len == kva)
+            segs[n - 1].len += len;
+        else if (n == WRITE_MAX_SEGS)
+            return 0;
+        else
+            segs[n++] = (uart_sg) {.buf = kva, .len = len};
+
+        va += len;
+    }
+
+    return n;
+}
+
+
+static void write_done(void* arg)
+{
+    thread* th = arg;
+
+    // from the irq, the task lock could be held by the interrupted thread
+    __atomic_fetch_sub(&th->task.utask->zc_writes, 1, __ATOMIC_RELEASE);
+
+    wait_queue_wake(&write_wq, (uintptr_t)th, 1);
+}
+
+
+int64_t sysc_write(const uint64_t args[6])
+{
+    const uintptr_t buf = args[0];
+    const size_t size = args[1];
+
+    thread* th = scheduler_current_thread();
+    utask* t = th->task.utask;
+    uart_sg segs[WRITE_MAX_SEGS];
+    size_t n = 0;
+
+    if (!umalloc_user_readable(t, buf, size))
+        return SYSC_ERR_FAULT;
+
+    // the pages stay mapped until write_done, sysc_munmap refuses to free
+    // them while zc_writes is not 0
+    if (size >= WRITE_ZC_MIN) {
+        spinlocked(&t->lock)
+        {
+            n = write_segments(t, buf, size, segs);
+
+            if (n > 0)
+                __atomic_fetch_add(&t->zc_writes, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (n > 0) {
+        segs[n - 1].done = write_done;
+        segs[n - 1].arg = th;
+
+        // the uart can not wake the thread before it sleeps, the irq takes the
+        // lock of the queue
+        spinlocked(&write_wq.lock)
+        {
+            if (uart_write_sg(&UART2_DRIVER, segs, n)) {
+                th->ctx.x[0] = size;
+                wait_queue_sleep_locked(&write_wq, (uintptr_t)th);
+            }
+            else
+                n = 0;
+        }
+
+        // the writer sleeps until the uart is done with its pages
+        if (n > 0)
+            return SYSC_RESULT_STORED;
+
+        __atomic_fetch_sub(&t->zc_writes, 1, __ATOMIC_RELEASE);
+    }
+
+    // small, fragmented, shared with a clone or the segment queue is full
+    fkwrite(IO_STDOUT, (const char*)buf, size);
+
+    return (int64_t)size;
+}
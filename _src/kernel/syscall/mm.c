@@ -0,0 +1,190 @@
+#include <kernel/mm.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/sysring.h>
+#include <kernel/vtime.h>
+#include <lib/lock/spinlock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/mem.h"
+
+// upper bound of a single SYSC_MAP
+#define SYSC_MAP_MAX_PAGES 4096
+
+// upper bound of a single SYSC_MMAP, only reserved until touched
+#define SYSC_MMAP_MAX_PAGES (1U << 18)
+
+
+/// [va, va + bytes) fits under the vtime page, written so it can not overflow.
+/// The first page stays unmapped to catch null pointers
+static bool range_valid(uintptr_t va, size_t bytes)
+{
+    return va >= KPAGE_SIZE && va <= VTIME_USR_VA &&
+           bytes <= VTIME_USR_VA - va;
+}
+
+
+int64_t sysc_map_locked(utask* t, uint32_t pages, void** kva)
+{
+    const uintptr_t va = t->map_next;
+    const size_t bytes = (size_t)pages * KPAGE_SIZE;
+
+    // a SYSC_MMAP at a hint may already hold the next va
+    if (!range_valid(va, bytes) || umalloc_region_exists(t, va, bytes))
+        return SYSC_ERR_INVAL;
+
+    *kva = umalloc(t, va, pages, true, true, false, true);
+
+    if (!*kva)
+        return SYSC_ERR_NOMEM;
+
+    t->map_next += bytes;
+
+    return (int64_t)va;
+}
+
+
+int64_t sysc_map(const uint64_t args[6])
+{
+    const uint32_t pages = (uint32_t)args[0];
+
+    utask* t = scheduler_current_utask();
+    int64_t res;
+    void* kva;
+
+    if (pages == 0 || pages > SYSC_MAP_MAX_PAGES)
+        return SYSC_ERR_INVAL;
+
+    spinlocked(&t->lock)
+    {
+        res = sysc_map_locked(t, pages, &kva);
+    }
+
+    if (res < 0)
+        return res;
+
+    // through the kernel access, before the va is returned
+    memzero(kva, (size_t)pages * KPAGE_SIZE);
+
+    return res;
+}
+
+
+/// the prot of SYSC_MMAP and SYSC_MPROTECT, false if it is not R, RW or RX
+static bool prot_valid(uint64_t prot)
+{
+    return prot == SYSC_PROT_READ ||
+           prot == (SYSC_PROT_READ | SYSC_PROT_WRITE) ||
+           prot == (SYSC_PROT_READ | SYSC_PROT_EXEC);
+}
+
+
+/// pages of len, 0 if it is 0 or over SYSC_MMAP_MAX_PAGES
+static uint32_t len_pages(uint64_t len)
+{
+    if (len == 0 || len > (uint64_t)SYSC_MMAP_MAX_PAGES * KPAGE_SIZE)
+        return 0;
+
+    return (uint32_t)((len + KPAGE_SIZE - 1) / KPAGE_SIZE);
+}
+
+
+int64_t sysc_mmap(const uint64_t args[6])
+{
+    const uintptr_t hint = args[0];
+    const uint32_t pages = len_pages(args[1]);
+    const uint64_t prot = args[2];
+
+    utask* t = scheduler_current_utask();
+    int64_t res = SYSC_ERR_INVAL;
+
+    if (pages == 0 || !prot_valid(prot) || hint % KPAGE_SIZE != 0)
+        return SYSC_ERR_INVAL;
+
+    const size_t bytes = (size_t)pages * KPAGE_SIZE;
+
+    spinlocked(&t->lock)
+    {
+        uintptr_t va = hint ? hint : t->map_next;
+
+        if (range_valid(va, bytes) && !umalloc_region_exists(t, va, bytes)) {
+            if (va + bytes > t->map_next)
+                t->map_next = va + bytes;
+
+            // reserved only, the pages are assigned by the faults
+            umalloc(
+                t,
+                va,
+                pages,
+                true,
+                prot & SYSC_PROT_WRITE,
+                prot & SYSC_PROT_EXEC,
+                false);
+
+            res = (int64_t)va;
+        }
+    }
+
+    return res;
+}
+
+
+int64_t sysc_munmap(const uint64_t args[6])
+{
+    const uintptr_t va = args[0];
+    const uint32_t pages = len_pages(args[1]);
+
+    utask* t = scheduler_current_utask();
+    int64_t res = SYSC_ERR_INVAL;
+
+    if (pages == 0 || va % KPAGE_SIZE != 0 ||
+        !range_valid(va, (size_t)pages * KPAGE_SIZE))
+        return SYSC_ERR_INVAL;
+
+    spinlocked(&t->lock)
+    {
+        // the uart may still be reading pages of a zero copy write
+        if (__atomic_load_n(&t->zc_writes, __ATOMIC_ACQUIRE) != 0)
+            res = SYSC_ERR_AGAIN;
+
+        // only whole regions, and never the syscall ring the kernel reads
+        else if (umalloc_region_is(t, va, pages) &&
+                 !(t->ring && umalloc_user_kva(t, va) == t->ring->shared)) {
+            ufree(t, va);
+            res = 0;
+        }
+    }
+
+    return res;
+}
+
+
+int64_t sysc_mprotect(const uint64_t args[6])
+{
+    const uintptr_t va = args[0];
+    const uint32_t pages = len_pages(args[1]);
+    const uint64_t prot = args[2];
+
+    utask* t = scheduler_current_utask();
+    bool ok;
+
+    if (pages == 0 || !prot_valid(prot) || va % KPAGE_SIZE != 0 ||
+        !range_valid(va, (size_t)pages * KPAGE_SIZE))
+        return SYSC_ERR_INVAL;
+
+    spinlocked(&t->lock)
+    {
+        ok = umalloc_protect(
+            t,
+            va,
+            pages,
+            true,
+            prot & SYSC_PROT_WRITE,
+            prot & SYSC_PROT_EXEC);
+    }
+
+    return ok ? 0 : SYSC_ERR_INVAL;
+}
@@ -0,0 +1,127 @@
+#include <kernel/mm.h>
+#include <kernel/mm/umalloc.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/sysring.h>
+#include <lib/lock/spinlock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/mem.h"
+#include "lib/stdmacros.h"
+
+_Static_assert(sizeof(sysc_ring) <= SYSC_RING_SQ_OFF, "sysc_ring too big");
+_Static_assert(sizeof(sysc_sqe) == 64, "sysc_sqe must be a cache line");
+
+
+int64_t sysc_ring_setup(const uint64_t args[6])
+{
+    const uint32_t entries = (uint32_t)args[0];
+
+    utask* t = scheduler_current_utask();
+
+    if (entries == 0 || entries > SYSC_RING_MAX_ENTRIES ||
+        (entries & (entries - 1)) != 0)
+        return SYSC_ERR_INVAL;
+
+    sysc_ring_state* rs = kmalloc(sizeof(sysc_ring_state));
+
+    if (!rs)
+        return SYSC_ERR_NOMEM;
+
+    const uint32_t pages = DIV_CEIL(SYSC_RING_BYTES(entries), KPAGE_SIZE);
+    int64_t res = SYSC_ERR_AGAIN;
+    void* kva;
+
+    spinlocked(&t->lock)
+    {
+        // one ring per task
+        if (!t->ring)
+            res = sysc_map_locked(t, pages, &kva);
+
+        if (res >= 0) {
+            sysc_ring* r = kva;
+
+            // ready before the other threads of the task can see it
+            memzero(r, (size_t)pages * KPAGE_SIZE);
+            r->entries = entries;
+            r->sq_off = SYSC_RING_SQ_OFF;
+            r->cq_off = SYSC_RING_SQ_OFF + entries * sizeof(sysc_sqe);
+
+            *rs = (sysc_ring_state) {
+                .shared = r,
+                .entries = entries,
+                .sq_head = 0,
+                .cq_tail = 0,
+                .busy = 0,
+            };
+
+            t->ring = rs;
+        }
+    }
+
+    if (res < 0)
+        kfree(rs);
+
+    return res;
+}
+
+
+int64_t sysc_ring_enter(const uint64_t args[6])
+{
+    const uint32_t n = (uint32_t)args[0];
+
+    sysc_ring_state* rs = scheduler_current_utask()->ring;
+
+    if (!rs)
+        return SYSC_ERR_INVAL;
+
+    // the indices are not shared between the threads of the task, one runs
+    // the ring at a time
+    if (__atomic_exchange_n(&rs->busy, 1, __ATOMIC_ACQUIRE))
+        return SYSC_ERR_AGAIN;
+
+    volatile sysc_ring* r = rs->shared;
+    sysc_sqe* sq = (sysc_sqe*)((uintptr_t)r + SYSC_RING_SQ_OFF);
+    sysc_cqe* cq = (sysc_cqe*)((uintptr_t)sq + rs->entries * sizeof(sysc_sqe));
+    const uint32_t mask = rs->entries - 1;
+
+    // written by the user, a bogus index only limits the batch
+    uint32_t sq_tail = __atomic_load_n(&r->sq_tail, __ATOMIC_ACQUIRE);
+    uint32_t pending = sq_tail - rs->sq_head;
+
+    if (pending > rs->entries)
+        pending = 0;
+    if (pending > n)
+        pending = n;
+
+    uint32_t done = 0;
+
+    while (done < pending) {
+        uint32_t cq_head = __atomic_load_n(&r->cq_head, __ATOMIC_ACQUIRE);
+
+        // cq full, the user has to reap completions first
+        if (rs->cq_tail - cq_head >= rs->entries)
+            break;
+
+        // copied, the user can change the entry while it runs
+        sysc_sqe e = sq[rs->sq_head & mask];
+
+        cq[rs->cq_tail & mask] = (sysc_cqe) {
+            .user_data = e.user_data,
+            .result = sysc_run_batched(e.nr, e.args),
+        };
+
+        rs->sq_head++;
+        rs->cq_tail++;
+        done++;
+
+        __atomic_store_n(&r->cq_tail, rs->cq_tail, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&r->sq_head, rs->sq_head, __ATOMIC_RELEASE);
+    __atomic_store_n(&rs->busy, 0, __ATOMIC_RELEASE);
+
+    return done;
+}
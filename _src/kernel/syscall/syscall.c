@@ -0,0 +1,214 @@
+#include <arm/exceptions/exceptions.h>
+#include <kernel/bench.h>
+#include <kernel/mm.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/sysring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define ARGS(...) .args = {__VA_ARGS__}
+
+static const syscall_desc SYSCALL_TABLE[SYSC_COUNT] = {
+    [SYSC_PRINT] = {
+        .fn = sysc_print,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64),
+        .batch = true,
+    },
+    [SYSC_MAP] = {
+        .fn = sysc_map,
+        ARGS(SYSC_ARG_U32),
+        .batch = true,
+    },
+    [SYSC_FUTEX_WAIT] = {
+        .fn = sysc_futex_wait,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U32),
+    },
+    [SYSC_FUTEX_WAKE] = {
+        .fn = sysc_futex_wake,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64),
+        .batch = true,
+    },
+#ifdef BENCH
+    // not fast, the switch test needs the scheduling point of every svc
+    [SYSC_BENCH] = {
+        .fn = sysc_bench,
+        ARGS(SYSC_ARG_U64, SYSC_ARG_U64),
+    },
+#endif
+    [SYSC_GETPID] = {
+        .fn = sysc_getpid,
+        .fast = sysc_getpid,
+        .batch = true,
+    },
+    [SYSC_GETTID] = {
+        .fn = sysc_gettid,
+        .fast = sysc_gettid,
+        .batch = true,
+    },
+    [SYSC_CLOCK] = {
+        .fn = sysc_clock,
+        .fast = sysc_clock,
+        .batch = true,
+    },
+    [SYSC_YIELD] = {
+        .fn = sysc_yield,
+        .fast = sysc_yield_fast,
+    },
+    [SYSC_RING_SETUP] = {
+        .fn = sysc_ring_setup,
+        ARGS(SYSC_ARG_U32),
+    },
+    [SYSC_RING_ENTER] = {
+        .fn = sysc_ring_enter,
+        ARGS(SYSC_ARG_U32),
+    },
+    [SYSC_WRITE] = {
+        .fn = sysc_write,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64),
+    },
+    [SYSC_MMAP] = {
+        .fn = sysc_mmap,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64, SYSC_ARG_U64),
+        .batch = true,
+    },
+    [SYSC_MUNMAP] = {
+        .fn = sysc_munmap,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64),
+        .batch = true,
+    },
+    [SYSC_MPROTECT] = {
+        .fn = sysc_mprotect,
+        ARGS(SYSC_ARG_UPTR, SYSC_ARG_U64, SYSC_ARG_U64),
+        .batch = true,
+    },
+    [SYSC_SET_PRIORITY] = {
+        .fn = sysc_set_priority,
+        ARGS(SYSC_ARG_U32),
+    },
+    [SYSC_FUTEX_LOCK_PI] = {
+        .fn = sysc_futex_lock_pi,
+        ARGS(SYSC_ARG_UPTR),
+    },
+    [SYSC_FUTEX_UNLOCK_PI] = {
+        .fn = sysc_futex_unlock_pi,
+        ARGS(SYSC_ARG_UPTR),
+    },
+    [SYSC_SLEEP] = {
+        .fn = sysc_sleep,
+        ARGS(SYSC_ARG_U64),
+    },
+    [SYSC_CLOCK_SETTIME] = {
+        .fn = sysc_clock_settime,
+        ARGS(SYSC_ARG_U32, SYSC_ARG_U64),
+        .batch = true,
+    },
+};
+
+
+/// returns the entry of the syscall nr, NULL if there is none
+static inline const syscall_desc* sysc_desc(uint64_t nr)
+{
+    if (nr >= SYSC_COUNT || !SYSCALL_TABLE[nr].fn)
+        return NULL;
+
+    return &SYSCALL_TABLE[nr];
+}
+
+
+/// copies the args of the syscall to args, checked by their kind. Unused args
+/// are zeroed, so handlers never see stale registers. Returns 0 or the error
+static int64_t sysc_marshal(
+    const syscall_desc* d,
+    const uint64_t in[6],
+    uint64_t args[6])
+{
+    for (size_t i = 0; i < 6; i++) {
+        uint64_t v = in[i];
+
+        switch ((syscall_arg)d->args[i]) {
+            case SYSC_ARG_NONE:
+                v = 0;
+                break;
+
+            case SYSC_ARG_U64:
+                break;
+
+            case SYSC_ARG_U32:
+                if (v > UINT32_MAX)
+                    return SYSC_ERR_INVAL;
+                break;
+
+            case SYSC_ARG_UPTR:
+                if (is_kva_uintptr_t(v))
+                    return SYSC_ERR_FAULT;
+                break;
+        }
+
+        args[i] = v;
+    }
+
+    return 0;
+}
+
+
+bool sysc64_fast(arm_exception_ctx* ectx)
+{
+    const syscall_desc* d = sysc_desc(ectx->x[8]);
+    uint64_t args[6];
+
+    if (!d || !d->fast)
+        return false;
+
+    // a bad arg is not worth the slow path, it only returns the error
+    int64_t result = sysc_marshal(d, ectx->x, args);
+
+    if (result == 0)
+        result = d->fast(args);
+
+    if (result == SYSC_RESULT_SLOW)
+        return false;
+
+    // the thread was not saved, the exception exit loads ectx
+    ectx->x[0] = (uint64_t)result;
+    return true;
+}
+
+
+void sysc64_dispatch(arm_exception_ctx* ectx)
+{
+    thread* th = scheduler_current_thread();
+    const syscall_desc* d = sysc_desc(ectx->x[8]);
+    uint64_t args[6];
+    int64_t result = SYSC_ERR_NOSYS;
+
+    if (d) {
+        result = sysc_marshal(d, ectx->x, args);
+
+        if (result == 0)
+            result = d->fn(args);
+    }
+
+    // the exception exit loads the context of the thread, not ectx
+    if (result != SYSC_RESULT_STORED)
+        th->ctx.x[0] = (uint64_t)result;
+}
+
+
+int64_t sysc_run_batched(uint64_t nr, const uint64_t in[6])
+{
+    const syscall_desc* d = sysc_desc(nr);
+    uint64_t args[6];
+
+    if (!d)
+        return SYSC_ERR_NOSYS;
+
+    if (!d->batch)
+        return SYSC_ERR_INVAL;
+
+    int64_t result = sysc_marshal(d, in, args);
+
+    return result == 0 ? d->fn(args) : result;
+}
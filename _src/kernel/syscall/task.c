@@ -0,0 +1,93 @@
+#include <drivers/arm_generic_timer/arm_generic_timer.h>
+#include <kernel/scheduler.h>
+#include <kernel/syscall.h>
+#include <kernel/vtime.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ *  Syscalls of the thread and the clocks. The register only ones have a fast
+ *  handler (kernel/syscall.h)
+ */
+
+
+int64_t sysc_getpid(const uint64_t[6])
+{
+    return (int64_t)scheduler_current_utask()->task_uid;
+}
+
+
+int64_t sysc_gettid(const uint64_t[6])
+{
+    return (int64_t)scheduler_current_thread()->th_uid;
+}
+
+
+int64_t sysc_clock(const uint64_t[6])
+{
+    return (int64_t)AGT_cnt_time_ns();
+}
+
+
+int64_t sysc_clock_settime(const uint64_t args[6])
+{
+    if (args[0] != SYSC_CLOCK_REALTIME)
+        return SYSC_ERR_INVAL;
+
+    // published through the time page, read by clock_gettime of every task
+    vtime_set_realtime(args[1]);
+
+    return 0;
+}
+
+
+int64_t sysc_set_priority(const uint64_t args[6])
+{
+    const uint32_t prio = (uint32_t)args[0];
+
+    if (prio >= SCHED_RT_PRIOS)
+        return SYSC_ERR_INVAL;
+
+    // a lowered thread gives the core at the scheduling point after the call
+    scheduler_set_priority(scheduler_current_thread(), (uint8_t)prio);
+
+    return 0;
+}
+
+
+int64_t sysc_yield_fast(const uint64_t[6])
+{
+    // alone in the core, the switch would resume the same thread
+    if (!scheduler_local_has_ready())
+        return 0;
+
+    return SYSC_RESULT_SLOW;
+}
+
+
+int64_t sysc_yield(const uint64_t[6])
+{
+    // the scheduling point after the syscall requeues the thread at the tail
+    return 0;
+}
+
+
+int64_t sysc_sleep(const uint64_t args[6])
+{
+    const uint64_t now = AGT_cnt_cycles();
+    uint64_t cycles = AGT_ns_to_cycles(args[0]);
+
+    if (cycles == 0)
+        return 0;
+
+    // UINT64_MAX is the no timer value of the core
+    if (cycles >= UINT64_MAX - now)
+        cycles = UINT64_MAX - now - 1;
+
+    // stored before the timer of the core can wake it
+    scheduler_current_thread()->ctx.x[0] = 0;
+    scheduler_sleep_until(now + cycles);
+
+    return SYSC_RESULT_STORED;
+}
@@ -0,0 +1,100 @@
+#include <arm/mmu.h>
+#include <arm/sysregs/arm_generic_timer.h>
+#include <drivers/arm_generic_timer/arm_generic_timer.h>
+#include <kernel/init.h>
+#include <kernel/mm.h>
+#include <kernel/scheduler.h>
+#include <kernel/vtime.h>
+#include <lib/lock/spinlock.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "kernel/panic.h"
+#include "lib/mem.h"
+
+#define CNTKCTL_EL0VCTEN (1UL << 1)
+#define NSEC_PER_SEC 1000000000ULL
+
+_Static_assert(
+    VTIME_USR_VA % (64 * 1024) == 0,
+    "VTIME_USR_VA must be aligned to the biggest kernel page");
+
+
+static vtime_data* vtime_page;
+static p_uintptr_t vtime_pa;
+
+// only the writers are serialized, the readers are el0 threads
+static spinlock_t vtime_lock = SPINLOCK_INIT;
+
+
+static void vtime_init()
+{
+    raw_kmalloc_info info;
+
+    vtime_page = raw_kmalloc(1, "vtime", &RAW_KMALLOC_KMAP_CFG, &info);
+    ASSERT(vtime_page, "vtime_init: could not allocate the time page");
+
+    vtime_pa = info.info.kmap.pv.pa;
+
+    memzero(vtime_page, KPAGE_SIZE);
+
+    uint64_t freq = AGT_cnt_freq();
+
+    // NSEC_PER_SEC < 2^30, so the shift by 32 fits
+    *vtime_page = (vtime_data) {
+        .seq = 0,
+        .shift = VTIME_SHIFT,
+        .mult = (NSEC_PER_SEC << VTIME_SHIFT) / freq,
+        .freq = freq,
+        .realtime_ns = 0,
+    };
+}
+KERNEL_INITCALL(vtime_init, KERNEL_INITCALL_STAGE1);
+
+
+void vtime_cpu_init(void)
+{
+    _ARM_CNTKCTL_EL1_set(_ARM_CNTKCTL_EL1_get() | CNTKCTL_EL0VCTEN);
+    asm volatile("isb");
+}
+
+
+void vtime_map(utask* t)
+{
+    DEBUG_ASSERT(vtime_page, "vtime_map: time page not initialized");
+
+    mmu_map_result mres = mmu_map(
+        &t->mapping,
+        VTIME_USR_VA,
+        vtime_pa,
+        KPAGE_SIZE,
+        mmu_pg_cfg_new(
+            0,
+            MMU_AP_EL0_RO_EL1_RO,
+            MMU_SH_INNER_SHAREABLE,
+            false,
+            true,
+            true,
+            true,
+            0),
+        NULL);
+
+    ASSERT(mres == MMU_MAP_OK);
+}
+
+
+void vtime_set_realtime(uint64_t ns)
+{
+    spinlocked(&vtime_lock)
+    {
+        volatile vtime_data* v = vtime_page;
+
+        v->seq++;
+        asm volatile("dmb ishst" ::: "memory");
+
+        v->realtime_ns = ns - AGT_cnt_time_ns();
+
+        asm volatile("dmb ishst" ::: "memory");
+        v->seq++;
+    }
+}
@@ -1,3 +1,4 @@
+#include <kernel/fpu.h>
 #include <kernel/panic.h>
 #include <lib/mem.h>
 #include <lib/string.h>
@@ -28,6 +29,7 @@ void* memcpy64_aligned(void* dst, const void* src, size_t size)
     if ((size & 63) != 0)
         PANIC("memcpy64_aligned: size is not a multiple of 64");
 
+    fpu_kernel_claim();
     return _memcpy64(dst, src, size);
 }
 
@@ -39,6 +41,7 @@ void* memcpy64(void* dst, const void* src, size_t size)
     if ((size & 63) != 0)
         PANIC("memcpy64: size is not a multiple of 64");
 
+    fpu_kernel_claim();
     return _memcpy64(dst, src, size);
 }
 
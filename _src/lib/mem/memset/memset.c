@@ -0,0 +1,27 @@
+#include <lib/mem.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t __attribute__((may_alias)) word_t;
+
+
+// gcc emits calls to memset for the zeroing of aggregates. Built with
+// -mgeneral-regs-only it never touches the simd registers, so unlike memzero it
+// runs without fpu_kernel_claim. The loops must not be turned back into a call
+__attribute__((optimize("no-tree-loop-distribute-patterns"))) void*
+memset(void* dst, int c, size_t size)
+{
+    uint8_t* d = dst;
+    const word_t w = (uint8_t)c * 0x0101010101010101ULL;
+
+    for (; size > 0 && ((uintptr_t)d & 7) != 0; size--)
+        *d++ = (uint8_t)c;
+
+    for (; size >= 8; size -= 8, d += 8)
+        *(word_t*)d = w;
+
+    for (; size > 0; size--)
+        *d++ = (uint8_t)c;
+
+    return dst;
+}
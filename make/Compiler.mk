@@ -8,4 +8,7 @@ OBJCOPY 	= $(COMPILER)objcopy
 OBJDUMP 	= $(COMPILER)objdump
 
 # Rust
-RUST		= cargo
\ No newline at end of file
+RUST		= cargo
+
+# Emulator
+QEMU		?= qemu-system-aarch64
@@ -5,7 +5,7 @@ DEFINES     ?=
 
 MARCH       ?= armv8-a
 MCPU        ?= cortex-a53+simd
-RS_TARGET	=  aarch64-unknown-none
+RS_TARGET	=  aarch64-unknown-none-softfloat
 CSTD		:= gnu17
 CPPSTD		:= gnu++20 
 
@@ -17,7 +17,7 @@ CX_FLAGS 	= $(OPT_LEVEL) $(DEFINES) -mgeneral-regs-only -Wall -Wextra -Werror -f
 C_FLAGS     = $(CX_FLAGS) -x c -std=$(CSTD)
 CPP_FLAGS   = $(CX_FLAGS) -x c++ -std=$(CPPSTD)
 
-LD_FLAGS    = -T linker.ld -Map $(MAP)
+LD_FLAGS    = -T linker.ld -Map $(MAP) --defsym=__KPAGE_SIZE=$(KPAGE_KiB)K
 
 $(OBJ_DIR)/drivers/%.o: C_FLAGS += -DDRIVERS
 $(OBJ_DIR)/kernel/%.o: C_FLAGS += -DKERNEL
@@ -12,3 +12,19 @@ endif
 include $(CONFIG_FILE)
 
 
+
+
+# Kernel page size / translation granule in KiB (4, 16 or 64)
+KPAGE_KiB ?= 4
+
+ifeq ($(filter $(KPAGE_KiB),4 16 64),)
+    $(error Unsupported KPAGE_KiB='$(KPAGE_KiB)'. Available: 4 16 64)
+endif
+
+DEFINES += -DKPAGE_KiB=$(KPAGE_KiB)
+
+
+# Scheduler time slice in microseconds
+SCHED_QUANTUM_US ?= 10000
+
+DEFINES += -DSCHED_QUANTUM_US=$(SCHED_QUANTUM_US)
@@ -0,0 +1,6 @@
+# std build that runs the benchmark of kernel/bench.h on boot and prints
+# its results on the uart. Add -DBENCH_CNTVCT to time with the generic timer
+# instead of the pmu cycle counter
+
+OPT_LEVEL 	= -O2
+DEFINES     += -DSTD -DBENCH
@@ -0,0 +1,75 @@
+#include <arm/exceptions/exceptions.h>
+#include <kernel/panic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mmu_sim.h"
+
+
+/*
+ *  Kernel symbols required by the table code
+ */
+arm_exception_status arm_exceptions_get_status()
+{
+    arm_exception_status s;
+    memset(&s, 0, sizeof(s));
+    return s;
+}
+
+
+_Noreturn void panic(panic_info panic_info)
+{
+    fprintf(
+        stderr,
+        "PANIC: %s (%s:%d)\n",
+        panic_info.message,
+        panic_info.info.manual_abort.location.file,
+        panic_info.info.manual_abort.location.line);
+    abort();
+}
+
+
+void panicr(panic_info panic_info)
+{
+    panic(panic_info);
+}
+
+
+void fpu_kernel_claim(void)
+{
+}
+
+
+void* _memzero(void* dst, size_t size)
+{
+    return memset(dst, 0, size);
+}
+
+
+void* _memzero64(void* dst16, size_t size64)
+{
+    return memset(dst16, 0, size64);
+}
+
+
+uint64_t _mmu_get_SCTLR_EL1(void)
+{
+    return 0;
+}
+
+
+/// there is no hardware walker, report a fault so callers use the software
+/// path
+uint64_t _mmu_at_S1E1R(uint64_t va)
+{
+    (void)va;
+    return 1;
+}
+
+
+void mmu_sim_apply_changes(void)
+{
+    mmu_sim_stats.tlb_flushes++;
+}
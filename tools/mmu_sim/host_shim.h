@@ -0,0 +1,12 @@
+#pragma once
+/*
+ *  Forced include (-include) of the host build. Replaces the barriers and tlb
+ * maintenance of the table code with a counter
+ */
+
+void mmu_sim_apply_changes(void);
+
+#define MMU_APPLY_CHANGES() mmu_sim_apply_changes()
+
+// memcpy is the one of the libc, there is no kernel fp state to claim
+#define MEM_HOST_LIBC
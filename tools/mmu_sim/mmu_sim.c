@@ -0,0 +1,558 @@
+/*
+ *  Host simulator of the mmu table code (_src/arm/mmu/mmu.c). Runs mmu_map,
+ * mmu_unmap, mmu_promote and mmu_translate with malloc backed tables, and
+ * checks the result with an independent software walker against a reference
+ * model of the va window.
+ *
+ *  usage: mmu_sim [fuzz|bench|all] [-g 4k|16k|64k] [-n ops] [-s seed]
+ */
+
+#include <arm/mmu.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mmu_sim.h"
+
+
+mmu_sim_stats_t mmu_sim_stats;
+
+
+/*
+ *  Table allocator
+ */
+static mmu_granularity alloc_g;
+
+static void* sim_alloc(size_t bytes)
+{
+    void* p = aligned_alloc(alloc_g, bytes);
+
+    if (!p) {
+        fprintf(stderr, "sim_alloc: out of memory\n");
+        exit(1);
+    }
+
+    memset(p, 0, bytes);
+    mmu_sim_stats.live_tbls++;
+
+    return p;
+}
+
+
+static void sim_free(void* addr)
+{
+    mmu_sim_stats.live_tbls--;
+    free(addr);
+}
+
+
+/*
+ *  Reference walker, written from the architecture rules and not from the
+ * table code
+ */
+#define DC_VALID (1ULL << 0)
+#define DC_TABLE (1ULL << 1)
+#define DC_CONT (1ULL << 52)
+#define DC_OA_MASK 0x0000FFFFFFFFF000ULL
+
+
+typedef struct {
+    unsigned page_bits;
+    unsigned index_bits;
+    unsigned max_level;
+} sim_geometry;
+
+
+static sim_geometry geometry(mmu_granularity g)
+{
+    unsigned pb = g == MMU_GRANULARITY_4KB    ? 12
+                : g == MMU_GRANULARITY_16KB ? 14
+                                            : 16;
+
+    return (sim_geometry) {
+        .page_bits = pb,
+        .index_bits = pb - 3,
+        .max_level = g == MMU_GRANULARITY_64KB ? 2 : 3,
+    };
+}
+
+
+static unsigned level_shift(sim_geometry geo, unsigned l)
+{
+    return geo.page_bits + geo.index_bits * (geo.max_level - l);
+}
+
+
+/// levels that can hold blocks without FEAT_LPA/LPA2
+static bool block_allowed(mmu_granularity g, unsigned l, unsigned max_level)
+{
+    if (g == MMU_GRANULARITY_4KB)
+        return l == 1 || l == 2;
+
+    return l == max_level - 1;
+}
+
+
+static unsigned contig_run(mmu_granularity g, unsigned l, unsigned max_level)
+{
+    switch (g) {
+        case MMU_GRANULARITY_4KB:
+            return 16;
+        case MMU_GRANULARITY_16KB:
+            return l == max_level ? 128 : 32;
+        case MMU_GRANULARITY_64KB:
+            return 32;
+    }
+
+    return 1;
+}
+
+
+static void fail(const char* what, uint64_t va)
+{
+    fprintf(stderr, "FAIL: %s (va 0x%llx)\n", what, (unsigned long long)va);
+    exit(1);
+}
+
+
+typedef struct {
+    bool mapped;
+    uint64_t pa;
+} sim_walk_result;
+
+
+static sim_walk_result sim_walk(const mmu_mapping* m, uint64_t va)
+{
+    const sim_geometry geo = geometry(m->g_);
+    const uint64_t* t = m->tbl_;
+
+    for (unsigned l = 0; l <= geo.max_level; l++) {
+        const unsigned sh = level_shift(geo, l);
+        const uint64_t d = t[(va >> sh) & ((1ULL << geo.index_bits) - 1)];
+
+        if (!(d & DC_VALID))
+            return (sim_walk_result) {.mapped = false};
+
+        if (l < geo.max_level && (d & DC_TABLE)) {
+            t = (const uint64_t*)(uintptr_t)(d & DC_OA_MASK);
+            continue;
+        }
+
+        if (l == geo.max_level && !(d & DC_TABLE))
+            fail("reserved descriptor at the last level", va);
+
+        if (l < geo.max_level && !block_allowed(m->g_, l, geo.max_level))
+            fail("block at a level without blocks", va);
+
+        const uint64_t span = 1ULL << sh;
+        const uint64_t oa = d & DC_OA_MASK;
+
+        if (oa % span != 0)
+            fail("unaligned block output address", va);
+
+        return (sim_walk_result) {
+            .mapped = true,
+            .pa = oa + (va % span),
+        };
+    }
+
+    fail("walk past the last level", va);
+    return (sim_walk_result) {0};
+}
+
+
+/// counts the reachable tables and checks the contiguous-hint runs
+static size_t
+sim_check_tables(const mmu_mapping* m, const uint64_t* t, unsigned l)
+{
+    const sim_geometry geo = geometry(m->g_);
+    const size_t entries = 1ULL << geo.index_bits;
+    const unsigned sh = level_shift(geo, l);
+    size_t n = 1;
+
+    const bool leaf_lvl =
+        l == geo.max_level || block_allowed(m->g_, l, geo.max_level);
+
+    if (l > 0 && leaf_lvl) {
+        const unsigned run = contig_run(m->g_, l, geo.max_level);
+
+        for (size_t r = 0; r < entries; r += run) {
+            unsigned hinted = 0;
+
+            for (unsigned k = 0; k < run; k++)
+                hinted += (t[r + k] & DC_CONT) != 0;
+
+            if (hinted == 0)
+                continue;
+
+            if (hinted != run)
+                fail("partially hinted contiguous run", 0);
+
+            const uint64_t base = t[r] & DC_OA_MASK;
+
+            if (base % ((uint64_t)run << sh) != 0)
+                fail("unaligned contiguous run", base);
+
+            for (unsigned k = 0; k < run; k++) {
+                const uint64_t d = t[r + k];
+
+                if (!(d & DC_VALID) || (l < geo.max_level && (d & DC_TABLE)) ||
+                    (d & DC_OA_MASK) != base + ((uint64_t)k << sh) ||
+                    (d & ~DC_OA_MASK) != (t[r] & ~DC_OA_MASK))
+                    fail("inconsistent contiguous run", base);
+            }
+        }
+    }
+
+    if (l == geo.max_level)
+        return n;
+
+    for (size_t i = 0; i < entries; i++)
+        if ((t[i] & DC_VALID) && (t[i] & DC_TABLE))
+            n += sim_check_tables(
+                m,
+                (const uint64_t*)(uintptr_t)(t[i] & DC_OA_MASK),
+                l + 1);
+
+    return n;
+}
+
+
+/*
+ *  Reference model: one entry per granule of the va window
+ */
+#define MODEL_VA_BASE (1ULL << 40)
+
+typedef struct {
+    uint64_t pa; // 0 = unmapped
+    uint8_t attr_index;
+    uint8_t ap;
+} model_entry;
+
+static model_entry* model;
+static size_t model_pages;
+
+
+static uint64_t rng_state;
+
+static uint64_t rnd()
+{
+    // xorshift64
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+
+static mmu_pg_cfg cfg_new(uint8_t attr_index, mmu_access_permission ap)
+{
+    return mmu_pg_cfg_new(
+        attr_index,
+        ap,
+        MMU_SH_INNER_SHAREABLE,
+        false,
+        true,
+        false,
+        true,
+        0);
+}
+
+
+static void model_check_page(mmu_mapping* m, size_t p)
+{
+    const uint64_t va = MODEL_VA_BASE + p * m->g_ + (rnd() % m->g_);
+    const model_entry e = model[p];
+    const sim_walk_result w = sim_walk(m, va);
+    const mmu_translation t = mmu_translate(m, va);
+
+    if (w.mapped != (e.pa != 0))
+        fail(
+            e.pa ? "mapped page not found by the walker"
+                 : "unmapped page found by the walker",
+            va);
+
+    if (t.mapped != w.mapped || (t.mapped && t.pa != w.pa))
+        fail("mmu_translate disagrees with the walker", va);
+
+    if (!w.mapped)
+        return;
+
+    if (w.pa != e.pa + (va % m->g_))
+        fail("wrong output address", va);
+
+    if (t.cfg.attr_index != e.attr_index || t.cfg.ap != e.ap)
+        fail("wrong attributes", va);
+}
+
+
+static void model_check_range(mmu_mapping* m, size_t first, size_t pages)
+{
+    for (size_t p = first; p < first + pages && p < model_pages; p++)
+        model_check_page(m, p);
+
+    // plus a sample of the whole window
+    for (size_t i = 0; i < 256; i++)
+        model_check_page(m, rnd() % model_pages);
+
+    if (sim_check_tables(m, m->tbl_, 0) != mmu_sim_stats.live_tbls)
+        fail("reachable tables differ from the allocated ones (leak)", 0);
+}
+
+
+/*
+ *  Fuzz
+ */
+static void fuzz(mmu_granularity g, size_t ops)
+{
+    const uint64_t window = g == MMU_GRANULARITY_4KB ? 4ULL << 30 : 16ULL << 30;
+    const sim_geometry geo = geometry(g);
+    // pages of a last level table
+    const size_t tbl_pages = 1ULL << geo.index_bits;
+
+    alloc_g = g;
+    mmu_sim_stats = (mmu_sim_stats_t) {0};
+
+    model_pages = window / g;
+    model = calloc(model_pages, sizeof(model_entry));
+
+    mmu_mapping m = mmu_mapping_new(MMU_LO, g, 48, 0, sim_alloc, sim_free);
+    mmu_op_info info = mmu_op_info_new();
+
+    for (size_t op = 0; op < ops; op++) {
+        size_t pages =
+            rnd() % 4 == 0 ? 1 + rnd() % (4 * tbl_pages) : 1 + rnd() % 64;
+        if (rnd() % 8 == 0)
+            pages = tbl_pages * (1 + rnd() % 3);
+
+        size_t first = rnd() % (model_pages - pages);
+        if (rnd() % 3 == 0)
+            first -= first % tbl_pages;
+
+        const uint64_t va = MODEL_VA_BASE + first * g;
+        const unsigned kind = rnd() % 10;
+
+        if (kind < 5) {
+            // aligned like the va (blocks and contiguous runs) or random
+            uint64_t pa = rnd() % 2
+                              ? (first * g) + (1ULL << 44)
+                              : ((rnd() % (1ULL << 20)) * g) + (1ULL << 45);
+            const uint8_t attr = rnd() % 4;
+            const mmu_access_permission ap =
+                rnd() % 2 ? MMU_AP_EL0_NONE_EL1_RW : MMU_AP_EL0_RW_EL1_RW;
+
+            const mmu_map_result r =
+                mmu_map(&m, va, pa, pages * g, cfg_new(attr, ap), &info);
+
+            if (r != MMU_MAP_OK)
+                fail("mmu_map failed", va);
+
+            for (size_t i = 0; i < pages; i++)
+                model[first + i] = (model_entry) {
+                    .pa = pa + i * g,
+                    .attr_index = attr,
+                    .ap = ap,
+                };
+        }
+        else if (kind < 8) {
+            if (mmu_unmap(&m, va, pages * g, &info) != MMU_UNMAP_OK)
+                fail("mmu_unmap failed", va);
+
+            for (size_t i = 0; i < pages; i++)
+                model[first + i].pa = 0;
+        }
+        else {
+            mmu_promote(&m, va, pages * g, &info);
+        }
+
+        model_check_range(&m, first, pages);
+    }
+
+    mmu_promote(&m, MODEL_VA_BASE, window, &info);
+    model_check_range(&m, 0, 0);
+
+    mmu_unmap(&m, MODEL_VA_BASE, window, &info);
+    memset(model, 0, model_pages * sizeof(model_entry));
+    model_check_range(&m, 0, 0);
+
+    if (mmu_sim_stats.live_tbls != 1)
+        fail("tables left after unmapping the whole window", 0);
+
+    printf(
+        "fuzz %2lluK: %zu ops ok, %zu tables allocated, %zu freed, %zu iters, "
+        "%zu tlb flushes\n",
+        (unsigned long long)g / 1024,
+        ops,
+        info.alocated_tbls,
+        info.freed_tbls,
+        info.iters,
+        mmu_sim_stats.tlb_flushes);
+
+    sim_free(m.tbl_);
+    free(model);
+}
+
+
+/*
+ *  Bench
+ */
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+static void bench_report(
+    const char* name,
+    mmu_granularity g,
+    double t,
+    size_t n,
+    mmu_op_info info)
+{
+    printf(
+        "bench %2lluK %-22s %9.3f ms %10.0f ops/s  tbls +%zu -%zu  iters %zu  "
+        "tlb flushes %zu\n",
+        (unsigned long long)g / 1024,
+        name,
+        t * 1e3,
+        (double)n / t,
+        info.alocated_tbls,
+        info.freed_tbls,
+        info.iters,
+        mmu_sim_stats.tlb_flushes);
+}
+
+
+#define BENCH(name, n, body)                                                   \
+    do {                                                                       \
+        mmu_op_info info = mmu_op_info_new();                                  \
+        mmu_sim_stats.tlb_flushes = 0;                                         \
+        const double t0 = now_s();                                             \
+        body;                                                                  \
+        bench_report(name, g, now_s() - t0, n, info);                          \
+    } while (0)
+
+
+static void bench(mmu_granularity g)
+{
+    const uint64_t size = 1ULL << 30;
+    const uint64_t va = 1ULL << 40;
+    const size_t pages = size / g;
+    const size_t lookups = 1 << 20;
+    const mmu_pg_cfg cfg = cfg_new(0, MMU_AP_EL0_NONE_EL1_RW);
+    volatile uint64_t sink = 0;
+
+    alloc_g = g;
+    mmu_sim_stats = (mmu_sim_stats_t) {0};
+
+    mmu_mapping m = mmu_mapping_new(MMU_LO, g, 48, 0, sim_alloc, sim_free);
+
+    BENCH("map 1G aligned", 1, mmu_map(&m, va, va, size, cfg, &info));
+    BENCH("unmap 1G", 1, mmu_unmap(&m, va, size, &info));
+
+    BENCH("map 1G page by page", pages, {
+        for (size_t i = 0; i < pages; i++)
+            mmu_map(&m, va + i * g, va + i * g, g, cfg, &info);
+    });
+
+    BENCH("translate random", lookups, {
+        for (size_t i = 0; i < lookups; i++)
+            sink += mmu_translate(&m, va + (rnd() % size)).pa;
+    });
+
+    BENCH("translate sequential", lookups, {
+        for (size_t i = 0; i < lookups; i++)
+            sink += mmu_translate(&m, va + (i * 64) % size).pa;
+    });
+
+    BENCH("promote 1G", 1, mmu_promote(&m, va, size, &info));
+    BENCH("unmap 1G page by page", pages, {
+        for (size_t i = 0; i < pages; i++)
+            mmu_unmap(&m, va + i * g, g, &info);
+    });
+
+    BENCH("map 1G unaligned pa", 1, mmu_map(&m, va, va + g, size, cfg, &info));
+    BENCH("unmap 1G", 1, mmu_unmap(&m, va, size, &info));
+
+    if (mmu_sim_stats.live_tbls != 1)
+        fail("tables left after the bench", 0);
+
+    sim_free(m.tbl_);
+    (void)sink;
+}
+
+
+static mmu_granularity parse_granule(const char* s)
+{
+    if (!strcmp(s, "4k"))
+        return MMU_GRANULARITY_4KB;
+    if (!strcmp(s, "16k"))
+        return MMU_GRANULARITY_16KB;
+    if (!strcmp(s, "64k"))
+        return MMU_GRANULARITY_64KB;
+
+    fprintf(stderr, "unknown granule %s\n", s);
+    exit(2);
+}
+
+
+static void usage()
+{
+    fprintf(
+        stderr,
+        "usage: mmu_sim [fuzz|bench|all] [-g 4k|16k|64k] [-n ops] [-s seed]\n");
+}
+
+
+int main(int argc, char** argv)
+{
+    const char* mode = argc > 1 ? argv[1] : "all";
+    size_t ops = 2000;
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    mmu_granularity gs[3] = {
+        MMU_GRANULARITY_4KB,
+        MMU_GRANULARITY_16KB,
+        MMU_GRANULARITY_64KB,
+    };
+    size_t n_gs = 3;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-g")) {
+            gs[0] = parse_granule(argv[i + 1]);
+            n_gs = 1;
+        }
+        else if (!strcmp(argv[i], "-n"))
+            ops = strtoull(argv[i + 1], NULL, 0);
+        else if (!strcmp(argv[i], "-s"))
+            seed = strtoull(argv[i + 1], NULL, 0);
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    const bool do_fuzz = !strcmp(mode, "fuzz") || !strcmp(mode, "all");
+    const bool do_bench = !strcmp(mode, "bench") || !strcmp(mode, "all");
+
+    if (!do_fuzz && !do_bench) {
+        usage();
+        return 2;
+    }
+
+    for (size_t i = 0; i < n_gs; i++) {
+        rng_state = seed ? seed : 1;
+
+        if (do_fuzz)
+            fuzz(gs[i], ops);
+        if (do_bench)
+            bench(gs[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct {
+    size_t live_tbls;
+    size_t tlb_flushes;
+} mmu_sim_stats_t;
+
+extern mmu_sim_stats_t mmu_sim_stats;
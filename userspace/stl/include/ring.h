@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Syscall ring: syscalls are posted to a queue shared with the kernel and run
+ *  in batches by ring_submit, one kernel entry for the whole batch. Only the
+ *  syscalls that do not sleep can be posted (print, map, futex wake, getpid,
+ *  gettid, clock), the others complete with SYSC_ERR_INVAL. One ring per task,
+ *  used by one thread at a time
+ */
+
+// must match kernel/sysring.h
+#define RING_MAX_ENTRIES 4096
+
+typedef struct {
+    uint64_t user_data;
+    uint32_t nr;
+    uint32_t _pad;
+    uint64_t args[6];
+} ring_sqe;
+
+typedef struct {
+    uint64_t user_data;
+    int64 result;
+} ring_cqe;
+
+typedef struct {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t entries;
+    uint32_t _pad;
+    uint64_t sq_off;
+    uint64_t cq_off;
+} ring;
+
+
+/// Maps the ring of the task, entries is a power of 2 up to RING_MAX_ENTRIES.
+/// NULL on error or if the task already has one
+ring* ring_setup(uint32_t entries);
+
+/// Next free sqe, NULL if the sq is full. It is posted by ring_submit
+ring_sqe* ring_get_sqe(ring* r);
+
+/// Fill sqe with a syscall, its completion gets user_data and the result the
+/// syscall would return
+void ring_prep_print(ring_sqe* sqe, const void* buf, size_t size, uint64_t ud);
+void ring_prep_map(ring_sqe* sqe, size_t pages, uint64_t ud);
+void ring_prep_futex_wake(
+    ring_sqe* sqe,
+    volatile uint32_t* uaddr,
+    size_t n,
+    uint64_t ud);
+void ring_prep_clock(ring_sqe* sqe, uint64_t ud);
+
+/// Posts the sqes got since the last submit and runs every pending one, returns
+/// how many ran or a negative error
+int64 ring_submit(ring* r);
+
+/// Oldest completion, NULL if there is none
+ring_cqe* ring_peek_cqe(ring* r);
+
+/// Releases the completion returned by ring_peek_cqe
+void ring_cqe_seen(ring* r);
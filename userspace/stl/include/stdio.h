@@ -1,5 +1,62 @@
 #pragma once
 
+#include <stdarg.h>
+#include <stddef.h>
 
+/*
+ *  Buffered output. Bytes are kept in the buffer of the stream and written
+ *  with one syscall when it fills, after a '\n' if it is line buffered, or on
+ *  fflush. stdout is line buffered and stderr is not buffered. The streams are
+ *  locked, so the threads of a task can share them without mixing their lines
+ */
+
+typedef struct FILE FILE;
+
+extern FILE* const stdout;
+extern FILE* const stderr;
+
+#define BUFSIZ 1024
+#define EOF (-1)
+
+// mode of setvbuf
+#define _IOFBF 0 // written when the buffer is full
+#define _IOLBF 1 // also written after each '\n'
+#define _IONBF 2 // written right away
+
+/// Sets the buffer and the mode of f, flushing it first. buf NULL keeps the
+/// current buffer. Returns 0 or EOF if the mode is not valid
+int setvbuf(FILE* f, char* buf, int mode, size_t size);
+
+/// Writes the buffered bytes of f, of every stream if it is NULL. Returns 0 or
+/// EOF if the write failed
+int fflush(FILE* f);
+
+int fputc(int c, FILE* f);
+int fputs(const char* s, FILE* f);
+size_t fwrite(const void* buf, size_t size, size_t n, FILE* f);
+
+int putchar(int c);
+
+/// Writes s and a '\n' to stdout
+int puts(const char* s);
+
+/// Writes s to stdout, without the '\n' of puts
 void print(const char* s);
-void printf(const char* s, ...);
+
+
+/*
+ *  Format of the kernel str_fmt_print: %c, %s, %d and %u (32 bit), %x (32 bit,
+ *  0x and uppercase digits), %p (64 bit hex), %b (64 bit binary) and %%. They
+ *  return the number of chars of the output
+ */
+
+int printf(const char* fmt, ...);
+int fprintf(FILE* f, const char* fmt, ...);
+
+/// Writes up to size - 1 chars and the '\0' to buf. Returns the length the
+/// whole output would have
+int snprintf(char* buf, size_t size, const char* fmt, ...);
+
+int vprintf(const char* fmt, va_list ap);
+int vfprintf(FILE* f, const char* fmt, va_list ap);
+int vsnprintf(char* buf, size_t size, const char* fmt, va_list ap);
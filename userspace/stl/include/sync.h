@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ *  Futex based mutex and condition variable. The uncontended paths are just
+ *  atomics, only a contended lock or a wait enters the kernel
+ */
+
+typedef struct {
+    // 0: unlocked, 1: locked, 2: locked with (possible) waiters
+    volatile uint32_t state;
+} mutex;
+
+#define MUTEX_INIT {.state = 0}
+
+void mutex_lock(mutex* m);
+int mutex_try_lock(mutex* m);
+void mutex_unlock(mutex* m);
+
+
+/// Mutex with priority inheritance: while a thread waits for it, the owner
+/// runs at least at its priority. The word holds the tid of the owner, the
+/// uncontended paths are a cas (and a gettid)
+typedef struct {
+    volatile uint32_t owner;
+} pi_mutex;
+
+#define PI_MUTEX_INIT {.owner = 0}
+
+void pi_mutex_lock(pi_mutex* m);
+void pi_mutex_unlock(pi_mutex* m);
+
+
+typedef struct {
+    volatile uint32_t seq; // bumped by every signal
+} cond;
+
+#define COND_INIT {.seq = 0}
+
+/// m must be locked, it is released while sleeping and locked again before
+/// returning. It can return spuriously, so the condition must be rechecked
+void cond_wait(cond* c, mutex* m);
+void cond_signal(cond* c);
+void cond_broadcast(cond* c);
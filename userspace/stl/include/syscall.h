@@ -1,15 +1,111 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 typedef enum {
     SYSC_PRINT_OK = 0,
-    SYSC_PRINT_INVALID_BUF = -2,
+    SYSC_PRINT_INVALID_BUF = -3, // SYSC_ERR_FAULT
 } sysc_print_results;
 
 sysc_print_results syscall_print(const void* buf, size_t size);
 
+/// Writes size bytes of buf to the uart, returns size or SYSC_ERR_FAULT. Big
+/// buffers are sent straight from their pages, the call returns once they are
+int64 syscall_write(const void* buf, size_t size);
 
-#define SYSCALL_MAP_PAGE_SIZE 4096
 
-void* syscall_map(size_t pages);
\ No newline at end of file
+// must match the KPAGE_KiB the kernel was built with
+#ifndef KPAGE_KiB
+#    define KPAGE_KiB 4
+#endif
+#define SYSCALL_MAP_PAGE_SIZE (KPAGE_KiB * 1024)
+
+void* syscall_map(size_t pages);
+
+
+// prot of syscall_mmap and syscall_mprotect, one of R, RW or RX
+#define PROT_READ 1
+#define PROT_WRITE 2
+#define PROT_EXEC 4
+
+/// Reserves len bytes of zeroed memory at addr, or anywhere if it is NULL. The
+/// pages are assigned on their first access. NULL on error
+void* syscall_mmap(void* addr, size_t len, uint32_t prot);
+
+/// Frees a whole region of syscall_mmap or syscall_map, 0 or SYSC_ERR_INVAL.
+/// SYSC_ERR_AGAIN while a big syscall_write of the task is being sent
+int64 syscall_munmap(void* addr, size_t len);
+
+/// Changes the access of a whole region, 0 or SYSC_ERR_INVAL
+int64 syscall_mprotect(void* addr, size_t len, uint32_t prot);
+
+
+// errors of every syscall, returned in place of the result
+typedef enum {
+    SYSC_ERR_NOSYS = -1,
+    SYSC_ERR_AGAIN = -2,
+    SYSC_ERR_FAULT = -3,
+    SYSC_ERR_INVAL = -4,
+    SYSC_ERR_NOMEM = -5,
+} sysc_results;
+
+
+typedef enum {
+    SYSC_FUTEX_OK = 0,
+    SYSC_FUTEX_AGAIN = -2,
+    SYSC_FUTEX_FAULT = -3,
+} sysc_futex_results;
+
+/// Sleeps while the u32 at uaddr is val. SYSC_FUTEX_AGAIN if it already
+/// changed
+sysc_futex_results syscall_futex_wait(volatile uint32_t* uaddr, uint32_t val);
+
+/// Wakes up to n threads sleeping on uaddr, returns how many were woken
+int64 syscall_futex_wake(volatile uint32_t* uaddr, size_t n);
+
+// word of a priority inheritance futex, must match kernel/syscall.h
+#define FUTEX_TID_MASK 0x3FFFFFFFU
+#define FUTEX_WAITERS 0x80000000U
+
+/// Takes the pi futex at uaddr, sleeping while another thread owns it. Its
+/// owner runs at least at the priority of the caller until it unlocks
+int64 syscall_futex_lock_pi(volatile uint32_t* uaddr);
+
+/// Releases the pi futex at uaddr to its most urgent waiter
+int64 syscall_futex_unlock_pi(volatile uint32_t* uaddr);
+
+
+/// Returns the id of the task
+int64 syscall_getpid(void);
+
+/// Returns the id of the thread
+int64 syscall_gettid(void);
+
+/// Returns the monotonic time in ns
+int64 syscall_clock(void);
+
+/// Gives the core to another ready thread, returns right away if there is none
+void syscall_yield(void);
+
+/// Sleeps the thread for at least ns, syscall_yield if it is 0
+void syscall_sleep(uint64_t ns);
+
+/// Sets the clock clk (a clockid_t of time.h) to ns since the epoch. Only
+/// CLOCK_REALTIME can be set, 0 or SYSC_ERR_INVAL
+int64 syscall_clock_settime(uint32_t clk, uint64_t ns);
+
+// priorities of syscall_set_priority, higher is more urgent
+#define SCHED_PRIO_BE 0
+#define SCHED_RT_PRIOS 32
+
+/// Sets the priority of the thread: SCHED_PRIO_BE, or a fixed real time one
+/// up to SCHED_RT_PRIOS - 1 that runs before every best effort thread
+int64 syscall_set_priority(uint32_t prio);
+
+
+/// Maps the syscall ring of the task (ring.h), NULL on error
+void* syscall_ring_setup(uint32_t entries);
+
+/// Runs up to n posted entries of the ring, returns how many ran
+int64 syscall_ring_enter(uint32_t n);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ *  clock_gettime reads the counter and the time page the kernel maps in every
+ *  task (kernel/vtime.h), it never enters the kernel
+ */
+
+// must match VTIME_USR_VA and vtime_data of the kernel
+#define VTIME_USR_VA 0xFFFFFFFF0000ULL
+
+typedef struct {
+    uint32_t seq; // odd while the kernel writes the page
+    uint32_t shift;
+    uint64_t mult;
+    uint64_t freq;
+    uint64_t realtime_ns;
+} vtime_data;
+
+
+typedef enum {
+    CLOCK_REALTIME = 0,
+    CLOCK_MONOTONIC = 1,
+} clockid_t;
+
+struct timespec {
+    int64 tv_sec;
+    int64 tv_nsec;
+};
+
+/// Returns 0, or -1 if clk is not a known clock
+int clock_gettime(clockid_t clk, struct timespec* ts);
+
+/// ns of clk, 0 if it is not a known clock
+uint64_t clock_gettime_ns(clockid_t clk);
+
+/// Sets CLOCK_REALTIME to ts. Returns 0, or -1 if clk is not CLOCK_REALTIME
+/// or ts is not a valid time
+int clock_settime(clockid_t clk, const struct timespec* ts);
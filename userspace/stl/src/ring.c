@@ -0,0 +1,117 @@
+#include <ring.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <syscall.h>
+
+// must match the syscall numbers of src/syscall/syscall.c
+#define NR_PRINT 0
+#define NR_MAP 1
+#define NR_FUTEX_WAKE 3
+#define NR_CLOCK 7
+
+
+// tail of the sqes got but not posted yet
+static uint32_t sq_next;
+
+
+static inline ring_sqe* sq_of(ring* r)
+{
+    return (ring_sqe*)((uintptr_t)r + r->sq_off);
+}
+
+static inline ring_cqe* cq_of(ring* r)
+{
+    return (ring_cqe*)((uintptr_t)r + r->cq_off);
+}
+
+
+ring* ring_setup(uint32_t entries)
+{
+    ring* r = syscall_ring_setup(entries);
+
+    if (r)
+        sq_next = r->sq_tail;
+
+    return r;
+}
+
+
+ring_sqe* ring_get_sqe(ring* r)
+{
+    uint32_t head = __atomic_load_n(&r->sq_head, __ATOMIC_ACQUIRE);
+
+    if (sq_next - head >= r->entries)
+        return (ring_sqe*)0;
+
+    return &sq_of(r)[sq_next++ & (r->entries - 1)];
+}
+
+
+static void prep(
+    ring_sqe* sqe,
+    uint32_t nr,
+    uint64_t ud,
+    uint64_t a0,
+    uint64_t a1)
+{
+    *sqe = (ring_sqe) {
+        .user_data = ud,
+        .nr = nr,
+        ._pad = 0,
+        .args = {a0, a1, 0, 0, 0, 0},
+    };
+}
+
+
+void ring_prep_print(ring_sqe* sqe, const void* buf, size_t size, uint64_t ud)
+{
+    prep(sqe, NR_PRINT, ud, (uint64_t)buf, size);
+}
+
+
+void ring_prep_map(ring_sqe* sqe, size_t pages, uint64_t ud)
+{
+    prep(sqe, NR_MAP, ud, pages, 0);
+}
+
+
+void ring_prep_futex_wake(
+    ring_sqe* sqe,
+    volatile uint32_t* uaddr,
+    size_t n,
+    uint64_t ud)
+{
+    prep(sqe, NR_FUTEX_WAKE, ud, (uint64_t)uaddr, n);
+}
+
+
+void ring_prep_clock(ring_sqe* sqe, uint64_t ud)
+{
+    prep(sqe, NR_CLOCK, ud, 0, 0);
+}
+
+
+int64 ring_submit(ring* r)
+{
+    // the sqes are written before the kernel can see the tail
+    __atomic_store_n(&r->sq_tail, sq_next, __ATOMIC_RELEASE);
+
+    return syscall_ring_enter(sq_next - r->sq_head);
+}
+
+
+ring_cqe* ring_peek_cqe(ring* r)
+{
+    uint32_t head = r->cq_head;
+
+    if (head == __atomic_load_n(&r->cq_tail, __ATOMIC_ACQUIRE))
+        return (ring_cqe*)0;
+
+    return &cq_of(r)[head & (r->entries - 1)];
+}
+
+
+void ring_cqe_seen(ring* r)
+{
+    __atomic_store_n(&r->cq_head, r->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -1,23 +1,424 @@
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sync.h>
 #include <syscall.h>
 
 
-void print(const char* s)
+struct FILE {
+    mutex lock;
+    char* buf;
+    size_t size;
+    size_t len;
+    int mode;
+};
+
+static char stdout_buf[BUFSIZ];
+
+static FILE streams[] = {
+    {
+        .lock = MUTEX_INIT,
+        .buf = stdout_buf,
+        .size = BUFSIZ,
+        .len = 0,
+        .mode = _IOLBF,
+    },
+    {
+        .lock = MUTEX_INIT,
+        .buf = (char*)0,
+        .size = 0,
+        .len = 0,
+        .mode = _IONBF,
+    },
+};
+
+FILE* const stdout = &streams[0];
+FILE* const stderr = &streams[1];
+
+#define STREAM_COUNT (sizeof(streams) / sizeof(streams[0]))
+
+
+static int write_out(const char* s, size_t n)
+{
+    if (n == 0)
+        return 0;
+
+    int64 result = syscall_write(s, n);
+
+    return result < 0 ? EOF : 0;
+}
+
+
+/// f->lock held
+static int flush_locked(FILE* f)
+{
+    int res = write_out(f->buf, f->len);
+
+    f->len = 0;
+
+    return res;
+}
+
+
+/// copies n bytes to the buffer of f, writing it as its mode says. f->lock held
+static int put_locked(FILE* f, const char* s, size_t n)
+{
+    int res = 0;
+
+    if (f->mode == _IONBF)
+        return write_out(s, n);
+
+    // too big to be buffered, written straight from s
+    if (n >= f->size) {
+        res = flush_locked(f);
+        return write_out(s, n) == EOF ? EOF : res;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (f->len == f->size && flush_locked(f) == EOF)
+            res = EOF;
+
+        f->buf[f->len++] = s[i];
+
+        if (s[i] == '\n' && f->mode == _IOLBF && flush_locked(f) == EOF)
+            res = EOF;
+    }
+
+    return res;
+}
+
+
+int setvbuf(FILE* f, char* buf, int mode, size_t size)
+{
+    if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+        return EOF;
+
+    if (mode != _IONBF && !buf && !f->buf)
+        return EOF;
+
+    mutex_lock(&f->lock);
+
+    int res = flush_locked(f);
+
+    if (buf && size) {
+        f->buf = buf;
+        f->size = size;
+    }
+
+    f->mode = mode;
+
+    mutex_unlock(&f->lock);
+
+    return res;
+}
+
+
+int fflush(FILE* f)
 {
-    const char* end = s;
+    if (f) {
+        mutex_lock(&f->lock);
+        int res = flush_locked(f);
+        mutex_unlock(&f->lock);
 
-    while (*end++) {
+        return res;
     }
 
-    size_t size = end - s;
+    int res = 0;
+
+    for (size_t i = 0; i < STREAM_COUNT; i++)
+        if (fflush(&streams[i]) == EOF)
+            res = EOF;
+
+    return res;
+}
+
+
+size_t fwrite(const void* buf, size_t size, size_t n, FILE* f)
+{
+    mutex_lock(&f->lock);
+    int res = put_locked(f, buf, size * n);
+    mutex_unlock(&f->lock);
+
+    return res == EOF ? 0 : n;
+}
+
+
+int fputc(int c, FILE* f)
+{
+    char ch = (char)c;
+
+    return fwrite(&ch, 1, 1, f) == 1 ? (unsigned char)ch : EOF;
+}
+
+
+int fputs(const char* s, FILE* f)
+{
+    size_t n = 0;
+
+    while (s[n])
+        n++;
+
+    return fwrite(s, 1, n, f) == n ? 0 : EOF;
+}
+
+
+int putchar(int c)
+{
+    return fputc(c, stdout);
+}
+
+
+int puts(const char* s)
+{
+    mutex_lock(&stdout->lock);
+
+    size_t n = 0;
+
+    while (s[n])
+        n++;
+
+    int res = put_locked(stdout, s, n);
+
+    if (put_locked(stdout, "\n", 1) == EOF)
+        res = EOF;
+
+    mutex_unlock(&stdout->lock);
+
+    return res;
+}
+
+
+void print(const char* s)
+{
+    fputs(s, stdout);
+}
+
+
+/* --- Format engine, the one of the kernel lib/string/fmt.c --- */
+
+typedef void (*fmt_putc)(char c, void* args);
+
+
+static void fmt_puts(fmt_putc putc, void* args, const char* s)
+{
+    while (*s)
+        putc(*s++, args);
+}
+
+
+static void fmt_int(
+    fmt_putc putc,
+    void* args,
+    uint64_t value,
+    int negative,
+    unsigned base,
+    const char* prefix)
+{
+    static const char DIGITS[16] = "0123456789ABCDEF";
+
+    char buf[64];
+    size_t i = 0;
+
+    do {
+        buf[i++] = DIGITS[value % base];
+        value /= base;
+    } while (value);
+
+    if (negative)
+        putc('-', args);
+
+    fmt_puts(putc, args, prefix);
+
+    while (i)
+        putc(buf[--i], args);
+}
+
+
+static void fmt_print(fmt_putc putc, void* args, const char* f, va_list ap)
+{
+    while (*f) {
+        if (*f != '%') {
+            putc(*f++, args);
+            continue;
+        }
+
+        f++;
+
+        switch (*f++) {
+            case '%':
+                putc('%', args);
+                break;
+
+            case 'c':
+                putc((char)va_arg(ap, int), args);
+                break;
+
+            case 's': {
+                const char* str = va_arg(ap, const char*);
+                if (!str)
+                    str = "(null)";
+                fmt_puts(putc, args, str);
+                break;
+            }
+
+            case 'd': {
+                int32_t v = va_arg(ap, int32_t);
+                uint64_t abs = v < 0 ? (uint64_t)-(int64)v : (uint64_t)v;
+                fmt_int(putc, args, abs, v < 0, 10, "");
+                break;
+            }
 
-    sysc_print_results result = syscall_print(s, size);
+            case 'u':
+                fmt_int(putc, args, va_arg(ap, uint32_t), 0, 10, "");
+                break;
 
-    if (result == SYSC_PRINT_INVALID_BUF) {
-        // TODO: exit()
+            case 'x':
+                fmt_int(putc, args, va_arg(ap, uint32_t), 0, 16, "0x");
+                break;
+
+            case 'p':
+                fmt_int(
+                    putc,
+                    args,
+                    (uint64_t)va_arg(ap, void*),
+                    0,
+                    16,
+                    "0x");
+                break;
+
+            case 'b':
+                fmt_int(
+                    putc,
+                    args,
+                    (uint64_t)va_arg(ap, void*),
+                    0,
+                    2,
+                    "0b");
+                break;
+
+            default:
+                putc('%', args);
+                putc(f[-1], args);
+                break;
+        }
     }
 }
 
 
-// TODO: void printf(const char* s, ...);
+// chars formatted on the stack before they are passed to the stream, so an
+// unbuffered one is not written char by char
+#define FMT_CHUNK 128
+
+typedef struct {
+    FILE* f;
+    char chunk[FMT_CHUNK];
+    size_t len;
+    size_t total;
+    int res;
+} stream_fmt;
+
+
+static void stream_drain(stream_fmt* s)
+{
+    if (put_locked(s->f, s->chunk, s->len) == EOF)
+        s->res = EOF;
+
+    s->len = 0;
+}
+
+
+static void stream_putc(char c, void* args)
+{
+    stream_fmt* s = args;
+
+    if (s->len == FMT_CHUNK)
+        stream_drain(s);
+
+    s->chunk[s->len++] = c;
+    s->total++;
+}
+
+
+int vfprintf(FILE* f, const char* fmt, va_list ap)
+{
+    stream_fmt s = {.f = f, .len = 0, .total = 0, .res = 0};
+
+    // the whole output at once, the lines of other threads are not mixed in
+    mutex_lock(&f->lock);
+    fmt_print(stream_putc, &s, fmt, ap);
+    stream_drain(&s);
+    mutex_unlock(&f->lock);
+
+    return s.res == EOF ? EOF : (int)s.total;
+}
+
+
+int vprintf(const char* fmt, va_list ap)
+{
+    return vfprintf(stdout, fmt, ap);
+}
+
+
+int fprintf(FILE* f, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vfprintf(f, fmt, ap);
+    va_end(ap);
+
+    return n;
+}
+
+
+int printf(const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vfprintf(stdout, fmt, ap);
+    va_end(ap);
+
+    return n;
+}
+
+
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t len;
+} buf_fmt;
+
+
+static void buf_putc(char c, void* args)
+{
+    buf_fmt* b = args;
+
+    if (b->len + 1 < b->size)
+        b->buf[b->len] = c;
+
+    b->len++;
+}
+
+
+int vsnprintf(char* buf, size_t size, const char* fmt, va_list ap)
+{
+    buf_fmt b = {.buf = buf, .size = size, .len = 0};
+
+    fmt_print(buf_putc, &b, fmt, ap);
+
+    if (size)
+        buf[b.len < size ? b.len : size - 1] = '\0';
+
+    return (int)b.len;
+}
+
+
+int snprintf(char* buf, size_t size, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+
+    return n;
+}
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <sync.h>
+#include <syscall.h>
+
+
+#define UNLOCKED 0
+#define LOCKED 1
+#define CONTENDED 2
+
+
+int mutex_try_lock(mutex* m)
+{
+    uint32_t c = UNLOCKED;
+
+    return __atomic_compare_exchange_n(
+        &m->state,
+        &c,
+        LOCKED,
+        0,
+        __ATOMIC_ACQUIRE,
+        __ATOMIC_RELAXED);
+}
+
+
+/// marks the lock as contended and sleeps until it is taken
+static void mutex_lock_contended(mutex* m)
+{
+    while (__atomic_exchange_n(&m->state, CONTENDED, __ATOMIC_ACQUIRE) !=
+           UNLOCKED)
+        syscall_futex_wait(&m->state, CONTENDED);
+}
+
+
+void mutex_lock(mutex* m)
+{
+    if (mutex_try_lock(m))
+        return;
+
+    mutex_lock_contended(m);
+}
+
+
+void mutex_unlock(mutex* m)
+{
+    // LOCKED -> UNLOCKED without entering the kernel if nobody waits
+    if (__atomic_exchange_n(&m->state, UNLOCKED, __ATOMIC_RELEASE) ==
+        CONTENDED)
+        syscall_futex_wake(&m->state, 1);
+}
+
+
+void pi_mutex_lock(pi_mutex* m)
+{
+    uint32_t expected = 0;
+    uint32_t tid = (uint32_t)syscall_gettid() & FUTEX_TID_MASK;
+
+    // taken by the kernel when owned, it boosts the owner while this waits
+    if (!__atomic_compare_exchange_n(
+            &m->owner,
+            &expected,
+            tid,
+            0,
+            __ATOMIC_ACQUIRE,
+            __ATOMIC_RELAXED))
+        syscall_futex_lock_pi(&m->owner);
+}
+
+
+void pi_mutex_unlock(pi_mutex* m)
+{
+    uint32_t expected = (uint32_t)syscall_gettid() & FUTEX_TID_MASK;
+
+    // with FUTEX_WAITERS set the word no longer matches, the kernel hands the
+    // lock to the most urgent waiter and drops the boost of this thread
+    if (!__atomic_compare_exchange_n(
+            &m->owner,
+            &expected,
+            0,
+            0,
+            __ATOMIC_RELEASE,
+            __ATOMIC_RELAXED))
+        syscall_futex_unlock_pi(&m->owner);
+}
+
+
+void cond_wait(cond* c, mutex* m)
+{
+    uint32_t seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+
+    mutex_unlock(m);
+
+    // a signal between the unlock and the sleep changes seq, so it returns
+    // SYSC_FUTEX_AGAIN instead of missing it
+    syscall_futex_wait(&c->seq, seq);
+
+    // other threads may be waiting too, keep the lock marked as contended so
+    // its unlock wakes them
+    mutex_lock_contended(m);
+}
+
+
+void cond_signal(cond* c)
+{
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    syscall_futex_wake(&c->seq, 1);
+}
+
+
+void cond_broadcast(cond* c)
+{
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    syscall_futex_wake(&c->seq, (size_t)-1);
+}
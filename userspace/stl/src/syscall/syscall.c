@@ -1,9 +1,28 @@
-#include <stddef.h>#include <syscall.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <syscall.h>
 
 typedef enum {
     SYSC_PRINT = 0,
     SYSC_MAP = 1,
+    SYSC_FUTEX_WAIT = 2,
+    SYSC_FUTEX_WAKE = 3,
+    SYSC_BENCH = 4,
+    SYSC_GETPID = 5,
+    SYSC_GETTID = 6,
+    SYSC_CLOCK = 7,
+    SYSC_YIELD = 8,
+    SYSC_RING_SETUP = 9,
+    SYSC_RING_ENTER = 10,
+    SYSC_WRITE = 11,
+    SYSC_MMAP = 12,
+    SYSC_MUNMAP = 13,
+    SYSC_MPROTECT = 14,
+    SYSC_SET_PRIORITY = 15,
+    SYSC_FUTEX_LOCK_PI = 16,
+    SYSC_FUTEX_UNLOCK_PI = 17,
+    SYSC_SLEEP = 18,
+    SYSC_CLOCK_SETTIME = 19,
 
     SYSC_COUNT,
 } syscall;
@@ -44,3 +63,109 @@ void* syscall_map(size_t pages)
 
     return (void*)result;
 }
+
+
+sysc_futex_results syscall_futex_wait(volatile uint32_t* uaddr, uint32_t val)
+{
+    return _syscall((uint64_t)uaddr, val, 0, 0, 0, 0, SYSC_FUTEX_WAIT);
+}
+
+
+int64 syscall_futex_wake(volatile uint32_t* uaddr, size_t n)
+{
+    return _syscall((uint64_t)uaddr, n, 0, 0, 0, 0, SYSC_FUTEX_WAKE);
+}
+
+
+int64 syscall_getpid(void)
+{
+    return _syscall(0, 0, 0, 0, 0, 0, SYSC_GETPID);
+}
+
+
+int64 syscall_gettid(void)
+{
+    return _syscall(0, 0, 0, 0, 0, 0, SYSC_GETTID);
+}
+
+
+int64 syscall_clock(void)
+{
+    return _syscall(0, 0, 0, 0, 0, 0, SYSC_CLOCK);
+}
+
+
+void syscall_yield(void)
+{
+    _syscall(0, 0, 0, 0, 0, 0, SYSC_YIELD);
+}
+
+
+void* syscall_ring_setup(uint32_t entries)
+{
+    int64 result = _syscall(entries, 0, 0, 0, 0, 0, SYSC_RING_SETUP);
+
+    return result < 0 ? (void*)0 : (void*)result;
+}
+
+
+int64 syscall_ring_enter(uint32_t n)
+{
+    return _syscall(n, 0, 0, 0, 0, 0, SYSC_RING_ENTER);
+}
+
+
+int64 syscall_write(const void* buf, size_t size)
+{
+    return _syscall((uint64_t)buf, size, 0, 0, 0, 0, SYSC_WRITE);
+}
+
+
+void* syscall_mmap(void* addr, size_t len, uint32_t prot)
+{
+    int64 result = _syscall((uint64_t)addr, len, prot, 0, 0, 0, SYSC_MMAP);
+
+    return result < 0 ? (void*)0 : (void*)result;
+}
+
+
+int64 syscall_munmap(void* addr, size_t len)
+{
+    return _syscall((uint64_t)addr, len, 0, 0, 0, 0, SYSC_MUNMAP);
+}
+
+
+int64 syscall_mprotect(void* addr, size_t len, uint32_t prot)
+{
+    return _syscall((uint64_t)addr, len, prot, 0, 0, 0, SYSC_MPROTECT);
+}
+
+
+int64 syscall_set_priority(uint32_t prio)
+{
+    return _syscall(prio, 0, 0, 0, 0, 0, SYSC_SET_PRIORITY);
+}
+
+
+int64 syscall_futex_lock_pi(volatile uint32_t* uaddr)
+{
+    return _syscall((uint64_t)uaddr, 0, 0, 0, 0, 0, SYSC_FUTEX_LOCK_PI);
+}
+
+
+int64 syscall_futex_unlock_pi(volatile uint32_t* uaddr)
+{
+    return _syscall((uint64_t)uaddr, 0, 0, 0, 0, 0, SYSC_FUTEX_UNLOCK_PI);
+}
+
+
+void syscall_sleep(uint64_t ns)
+{
+    _syscall(ns, 0, 0, 0, 0, 0, SYSC_SLEEP);
+}
+
+
+int64 syscall_clock_settime(uint32_t clk, uint64_t ns)
+{
+    return _syscall(clk, ns, 0, 0, 0, 0, SYSC_CLOCK_SETTIME);
+}
@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <syscall.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+
+static inline uint64_t read_counter(void)
+{
+    uint64_t cnt;
+
+    // not reordered with the reads of the page
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r"(cnt) : : "memory");
+
+    return cnt;
+}
+
+
+uint64_t clock_gettime_ns(clockid_t clk)
+{
+    const volatile vtime_data* v = (const volatile vtime_data*)VTIME_USR_VA;
+    uint32_t seq;
+    uint64_t ns, offset;
+
+    if (clk != CLOCK_REALTIME && clk != CLOCK_MONOTONIC)
+        return 0;
+
+    do {
+        seq = __atomic_load_n(&v->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        ns = (uint64_t)(((__uint128_t)read_counter() * v->mult) >> v->shift);
+        offset = clk == CLOCK_REALTIME ? v->realtime_ns : 0;
+
+        asm volatile("dmb ishld" ::: "memory");
+    } while ((seq & 1) || v->seq != seq);
+
+    return ns + offset;
+}
+
+
+int clock_gettime(clockid_t clk, struct timespec* ts)
+{
+    if (clk != CLOCK_REALTIME && clk != CLOCK_MONOTONIC)
+        return -1;
+
+    uint64_t ns = clock_gettime_ns(clk);
+
+    ts->tv_sec = (int64)(ns / NSEC_PER_SEC);
+    ts->tv_nsec = (int64)(ns % NSEC_PER_SEC);
+
+    return 0;
+}
+
+
+int clock_settime(clockid_t clk, const struct timespec* ts)
+{
+    if (clk != CLOCK_REALTIME || ts->tv_sec < 0 || ts->tv_nsec < 0 ||
+        ts->tv_nsec >= (int64)NSEC_PER_SEC)
+        return -1;
+
+    uint64_t ns = (uint64_t)ts->tv_sec * NSEC_PER_SEC + (uint64_t)ts->tv_nsec;
+
+    return syscall_clock_settime(clk, ns) == 0 ? 0 : -1;
+}